@@ -0,0 +1,66 @@
+/* tracedump.c
+ *
+ * This program reads a trace file written by Nachos (see
+ * threads/trace.h), and prints its events as text, one per line:
+ *
+ *	<ticks> cpu<n> <event>
+ *
+ * Usage: tracedump [trace file]	(default nachos.trace)
+ *
+ * The trace file is in the byte order of the host that wrote it, so
+ * it is to be decoded on the same kind of host.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation 
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h" 
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+static char *formats[] = TRACE_EVENT_FORMATS;
+
+int
+main(int argc, char **argv)
+{
+    char *fileName = (argc > 1) ? argv[1] : "nachos.trace";
+    TraceHeader header;
+    TraceRecord record;
+    FILE *file;
+    int i;
+
+    file = fopen(fileName, "rb");
+    if (file == NULL) {
+	perror(fileName);
+	exit(1);
+    }
+    if ((fread(&header, sizeof(header), 1, file) != 1)
+		|| (header.magic != TraceMagic)) {
+	fprintf(stderr, "%s: not a Nachos trace file\n", fileName);
+	exit(1);
+    }
+    if (header.lost > 0)
+	printf("(%d older events lost)\n", header.lost);
+
+    for (i = 0; i < header.count; i++) {
+	if (fread(&record, sizeof(record), 1, file) != 1) {
+	    fprintf(stderr, "%s: truncated after %d events\n", fileName, i);
+	    exit(1);
+	}
+	printf("%10d cpu%d ", record.ticks, record.cpu);
+	if ((record.event > 0) && (record.event < TR_NUM_EVENTS))
+	    printf(formats[record.event], record.arg0, record.arg1);
+	else
+	    printf("unknown event %d (%d, %d)", record.event, record.arg0,
+		   record.arg1);
+	printf("\n");
+    }
+    fclose(file);
+    return 0;
+}
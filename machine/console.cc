@@ -53,6 +53,7 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     readHandler = readAvail;
     handlerArg = callArg;
     putBusy = FALSE;
+    putCount = 0;
     incoming = EOF;
 
     // start polling for incoming packets
@@ -114,7 +115,7 @@ void
 Console::WriteDone()
 {
     putBusy = FALSE;
-    stats->numConsoleCharsWritten++;
+    stats->numConsoleCharsWritten += putCount;
     (*writeHandler)(handlerArg);
 }
 
@@ -145,6 +146,27 @@ Console::PutChar(char ch)
     ASSERT(putBusy == FALSE);
     WriteFile(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
+    putCount = 1;
+    interrupt->Schedule(ConsoleWriteDone, (int)this, ConsoleTime,
+					ConsoleWriteInt);
+}
+
+//----------------------------------------------------------------------
+// Console::PutChars()
+// 	Write "count" characters to the simulated display in a single
+//	transfer, like a serial port with a FIFO, and schedule one
+//	interrupt for all of them.  The transfer takes as long as
+//	writing a single character.
+//----------------------------------------------------------------------
+
+void
+Console::PutChars(char *buffer, int count)
+{
+    ASSERT(putBusy == FALSE);
+    ASSERT(count > 0);
+    WriteFile(writeFileNo, buffer, count);
+    putBusy = TRUE;
+    putCount = count;
     interrupt->Schedule(ConsoleWriteDone, (int)this, ConsoleTime,
 					ConsoleWriteInt);
 }
@@ -16,6 +16,7 @@
 #include "copyright.h"
 #include "disk.h"
 #include "system.h"
+#include "profile.h"
 
 // We put this at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file 
@@ -116,6 +117,7 @@ void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
     int ticks = ComputeLatency(sectorNumber, FALSE);
+    PROFILE(ProfDiskIO);
 
     ASSERT(!active);				// only one request at a time
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
@@ -136,6 +138,7 @@ void
 Disk::WriteRequest(int sectorNumber, char* data)
 {
     int ticks = ComputeLatency(sectorNumber, TRUE);
+    PROFILE(ProfDiskIO);
 
     ASSERT(!active);
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
@@ -23,12 +23,14 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#include "profile.h"
 
 // String definitions for debugging messages
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"quantum"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -48,6 +50,193 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    order = 0;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::PendingQueue, PendingQueue::~PendingQueue
+// 	Initialize an empty queue of pending interrupts; de-allocate it,
+//	along with the interrupts that never fired.
+//----------------------------------------------------------------------
+
+PendingQueue::PendingQueue()
+{
+    capacity = InitialPendingSize;
+    heap = new PendingInterrupt*[capacity];
+    size = 0;
+    nextOrder = 0;
+}
+
+PendingQueue::~PendingQueue()
+{
+    for (int i = 0; i < size; i++)
+	delete heap[i];
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Before
+// 	Return TRUE if "a" is due before "b", or at the same time and was
+//	scheduled first.  The scheduling numbers may wrap around.
+//----------------------------------------------------------------------
+
+bool
+PendingQueue::Before(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return a->when < b->when;
+    return (int)(a->order - b->order) < 0;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::SiftUp, PendingQueue::SiftDown
+// 	Put "toOccur" in the hole at slot "i": move it up past the
+//	interrupts due after it, or down past the earliest of its
+//	children until they are all due after it.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::SiftUp(int i, PendingInterrupt *toOccur)
+{
+    int parent;
+
+    for (; i > 0; i = parent) {
+	parent = (i - 1) / PendingArity;
+	if (!Before(toOccur, heap[parent]))
+	    break;
+	heap[i] = heap[parent];
+    }
+    heap[i] = toOccur;
+}
+
+void
+PendingQueue::SiftDown(int i, PendingInterrupt *toOccur)
+{
+    int child, best;
+
+    for (; ; i = best) {
+	best = -1;
+	for (child = PendingArity * i + 1;
+	     (child <= PendingArity * i + PendingArity) && (child < size);
+	     child++)
+	    if ((best < 0) || Before(heap[child], heap[best]))
+		best = child;
+	if ((best < 0) || !Before(heap[best], toOccur))
+	    break;
+	heap[i] = heap[best];
+    }
+    heap[i] = toOccur;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Insert
+// 	Add "toOccur" at the bottom of the heap, and move it up past the
+//	interrupts due after it.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Insert(PendingInterrupt *toOccur)
+{
+    if (size == capacity) {
+	PendingInterrupt **bigger = new PendingInterrupt*[2 * capacity];
+
+	for (int i = 0; i < size; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	capacity *= 2;
+    }
+    toOccur->order = nextOrder++;
+    SiftUp(size++, toOccur);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::RemoveMin
+// 	Take the earliest interrupt off the heap and return it, or NULL
+//	if there is none.  The last one takes its place, and is moved
+//	down past the earliest of its children until they are all due
+//	after it.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+PendingQueue::RemoveMin()
+{
+    PendingInterrupt *first;
+
+    if (size == 0)
+	return NULL;
+    first = heap[0];
+    size--;
+    if (size > 0)
+	SiftDown(0, heap[size]);
+    return first;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Remove
+// 	Take "toOccur" off the heap, wherever it is; return FALSE if it
+//	is not there.  The heap is searched, since it only ever holds an
+//	interrupt or two per device.  The last one takes its place, and
+//	is moved up or down to where it belongs.
+//----------------------------------------------------------------------
+
+bool
+PendingQueue::Remove(PendingInterrupt *toOccur)
+{
+    PendingInterrupt *last;
+    int i;
+
+    for (i = 0; (i < size) && (heap[i] != toOccur); i++)
+	;
+    if (i == size)
+	return FALSE;
+    last = heap[--size];
+    if (i < size) {
+	if ((i > 0) && Before(last, heap[(i - 1) / PendingArity]))
+	    SiftUp(i, last);
+	else
+	    SiftDown(i, last);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::NextAfterMin
+// 	Return the interrupt that is due after the earliest one, without
+//	taking either off: the earliest of the root's children.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+PendingQueue::NextAfterMin()
+{
+    PendingInterrupt *next = NULL;
+
+    for (int child = 1; (child <= PendingArity) && (child < size); child++)
+	if ((next == NULL) || Before(heap[child], next))
+	    next = heap[child];
+    return next;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Mapcar
+// 	Apply "func" to every pending interrupt, earliest first.  Only
+//	used for debugging, so it simply takes a copy of the heap apart.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Mapcar(VoidFunctionPtr func)
+{
+    PendingQueue *copy = new PendingQueue;
+    PendingInterrupt *toOccur;
+
+    delete [] copy->heap;
+    copy->heap = new PendingInterrupt*[capacity];
+    for (int i = 0; i < size; i++)
+	copy->heap[i] = heap[i];
+    copy->size = size;
+    while ((toOccur = copy->RemoveMin()) != NULL)
+	(*func)((int)toOccur);
+    delete copy;
 }
 
 //----------------------------------------------------------------------
@@ -60,10 +249,12 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new PendingQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    tickless = TRUE;
+    timerInterrupt = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -73,8 +264,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete pending->Remove();
     delete pending;
 }
 
@@ -162,6 +351,11 @@ Interrupt::OneTick()
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
+#ifdef USER_PROGRAM
+    if (numCPUs > 1)		// a multiprocessor takes its interrupts
+	return;			// between rounds, see FireDue
+#endif
+
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
@@ -178,6 +372,38 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::FireDue
+// 	Invoke the handlers of all interrupts that are due by now.  This
+//	is OneTick without advancing the clock or yielding; on a
+//	multiprocessor it is called once at the end of every lockstep
+//	round of the CPUs, instead of from OneTick on every tick.
+//----------------------------------------------------------------------
+
+void
+Interrupt::FireDue()
+{
+    IntStatus old = level;
+
+    ChangeLevel(old, IntOff);
+    while (CheckIfDue(FALSE))
+	;
+    ChangeLevel(IntOff, old);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RestoreLevel
+// 	Set the interrupt level without advancing the simulated time.
+//	Each simulated CPU has its own interrupt level; this reinstates
+//	it when a CPU gets the host back (see SwitchCPU).
+//----------------------------------------------------------------------
+
+void
+Interrupt::RestoreLevel(IntStatus now)
+{
+    ChangeLevel(level, now);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -212,6 +438,7 @@ Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    SkipTimerTicks();
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
@@ -233,6 +460,71 @@ Interrupt::Idle()
     Halt();
 }
 
+//----------------------------------------------------------------------
+// Interrupt::SkipTimerTicks
+// 	Move the periodic timer interrupt on past the ticks that would
+//	find nothing to do.  Called by Idle, when no thread can run until
+//	an interrupt makes one ready, and by the scheduler when it
+//	dispatches a thread under a policy that does not preempt it.  In
+//	both cases the timer handler has no quantum to end, so a tick
+//	only matters if a sleeping thread is due by then -- or, to be
+//	safe, if some other device interrupts before it.  The timer is
+//	moved to the first tick at or after the earlier of those two
+//	times, so that Idle can jump straight there, and a running thread
+//	is not interrupted for nothing.
+//
+//	The timer keeps its phase, so everything happens at the same
+//	simulated time as it would have.  That is only known for a
+//	periodic timer ("-rs" draws each interval at random), and on a
+//	uniprocessor (a multiprocessor runs in rounds aligned with the
+//	interrupts it takes; see cpu.cc).
+//
+//	A running thread can only add a sleeper by going to sleep
+//	itself, after which a thread is dispatched or Idle is called; so
+//	the timer is also moved back here, if a sleeper is now due before
+//	it.  With nothing else pending, the timer is moved on by at most
+//	MaxTimerSkip ticks while a thread runs; in Idle it is left at its
+//	next tick, so that Idle halts as it did.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SkipTimerTicks()
+{
+    PendingInterrupt *tick = timerInterrupt;
+    PendingInterrupt *other;
+    int until, skipped;
+
+    if (!tickless || (tick == NULL) || (tick->when <= stats->totalTicks)
+		|| (timer == NULL) || !timer->IsPeriodic())
+	return;				// (a tick that is due is taken)
+#ifdef USER_PROGRAM
+    if (numCPUs > 1)
+	return;
+#endif
+    until = sleepQueue->NextWakeup();
+    other = pending->Min();
+    if (other == tick)
+	other = pending->NextAfterMin();
+    if ((other != NULL) && ((until < 0) || (other->when < until)))
+	until = other->when;
+    if (until < 0)			// the timer is all there is
+	until = stats->totalTicks + ((status == IdleMode) ? 1 : MaxTimerSkip);
+    else if (until <= stats->totalTicks)
+	until = stats->totalTicks + 1;	// due now: the next tick
+    if (until > tick->when)		// later: skip ticks
+	skipped = divRoundUp(until - tick->when, TimerTicks);
+    else				// earlier: take them back
+	skipped = -((tick->when - until) / TimerTicks);
+    if (skipped == 0)
+	return;
+
+    DEBUG('i', "Moving the timer interrupt by %d periods, to time %d\n",
+		skipped, tick->when + skipped * TimerTicks);
+    (void) pending->Remove(tick);
+    tick->when += skipped * TimerTicks;
+    pending->Insert(tick);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
@@ -246,9 +538,14 @@ Interrupt::Halt()
 
     printf("Machine halting!\n\n");
     stats->Print();
+#ifdef USER_PROGRAM
+    if (numCPUs > 1)
+       PrintCPUStats();
+#endif
 
     if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
        printf("Error in burst estimate over average burst length: %.2f\n", ((float)stats->burstEstimateError)/stats->cpu_time);
+       scheduler->PrintPredictors();
     }
 
     if (excludeMainThread) {
@@ -291,6 +588,7 @@ Interrupt::Halt()
 
        printf("Completion time statistics for all threads: Max: %d, Min: %d, Avg: %.2f, Variance: %.2f\n", max_completion, min_completion, avg_completion, var_completion);
     }
+    scheduler->PrintFairness();
 
     Cleanup();     // Never returns.
 }
@@ -300,7 +598,7 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it in the heap of pending interrupts.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -310,8 +608,11 @@ Interrupt::Halt()
 //	"fromNow" is how far in the future (in simulated time) the 
 //		 interrupt is to occur
 //	"type" is the hardware device that generated the interrupt
+//
+//	Returns the interrupt, so that it can be cancelled before it
+//	fires.
 //----------------------------------------------------------------------
-void
+PendingInterrupt *
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
@@ -321,7 +622,45 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur);
+    if (type == TimerInt)
+	timerInterrupt = toOccur;	// see SkipTimerTicks
+    return toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Cancel
+// 	Take off "toOccur", an interrupt returned by Schedule that has
+//	not fired yet, and de-allocate it.  Left pending, an interrupt
+//	that has become pointless still has to be fired, and makes Idle
+//	stop at its time (see SkipTimerTicks).
+//----------------------------------------------------------------------
+void
+Interrupt::Cancel(PendingInterrupt *toOccur)
+{
+    DEBUG('i', "Cancelling interrupt handler the %s at time = %d\n",
+					intTypeNames[toOccur->type], toOccur->when);
+    if (toOccur == timerInterrupt)
+	timerInterrupt = NULL;
+    if (pending->Remove(toOccur))
+	delete toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextEventTime
+// 	Return the simulated time at which the earliest pending interrupt
+//	is due, or -1 if nothing is pending.  Until then OneTick has
+//	nothing to do but advance the clock, which is what lets
+//	Machine::Run execute user instructions in batches.  It is at
+//	the top of the heap, so this is cheap enough to ask every tick.
+//----------------------------------------------------------------------
+
+int
+Interrupt::NextEventTime()
+{
+    PendingInterrupt *next = pending->Min();
+
+    return (next != NULL) ? next->when : -1;
 }
 
 //----------------------------------------------------------------------
@@ -342,31 +681,32 @@ Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
     int when;
+    PROFILE(ProfCheckIfDue);
 
     ASSERT(level == IntOff);		// interrupts need to be disabled,
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = pending->Min();
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks) {	// not time yet, leave it
 	return FALSE;
     }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& (pending->Size() == 1))
 	 return FALSE;
-    }
+    (void) pending->RemoveMin();
+    if (toOccur == timerInterrupt)
+	timerInterrupt = NULL;		// the handler schedules the next
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
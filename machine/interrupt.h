@@ -50,7 +50,7 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 // In Nachos, we support a hardware timer device, a disk, a console
 // display and keyboard, and a network.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, QuantumInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -67,8 +67,57 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    unsigned order;		// when it was scheduled, to break ties
 };
 
+// The following class defines the set of pending interrupts, as a
+// 4-ary min-heap ordered by the time they are due: scheduling one,
+// and taking off the earliest, take O(log n), and finding when the
+// next one is due takes O(1).  Interrupts due at the same time come
+// out in the order they were scheduled, as they did from the sorted
+// list this replaces.
+
+#define PendingArity	4	// children of each node
+#define InitialPendingSize 16	// grows by doubling
+
+class PendingQueue {
+  public:
+    PendingQueue();			// Initialize an empty queue
+    ~PendingQueue();			// De-allocate it, and the
+					// interrupts still in it
+
+    void Insert(PendingInterrupt *toOccur);	// Add an interrupt
+    PendingInterrupt *Min() { return (size > 0) ? heap[0] : NULL; }
+					// The earliest; NULL if empty
+    PendingInterrupt *RemoveMin();	// Take the earliest off
+    bool Remove(PendingInterrupt *toOccur);
+					// Take this one off; FALSE if
+					// it is not in the queue
+    PendingInterrupt *NextAfterMin();	// The one due after the earliest;
+					// NULL if there is none
+    bool IsEmpty() { return (size == 0); }
+    int Size() { return size; }
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every interrupt,
+					// in the order they are due
+
+  private:
+    PendingInterrupt **heap;		// heap[0] is the earliest; the
+					// children of i are 4i+1 .. 4i+4
+    int size;				// interrupts in the heap
+    int capacity;			// room in "heap"
+    unsigned nextOrder;			// number of the next one scheduled
+
+    bool Before(PendingInterrupt *a, PendingInterrupt *b);
+					// is a due before b?
+    void SiftUp(int i, PendingInterrupt *toOccur);
+    void SiftDown(int i, PendingInterrupt *toOccur);
+					// fill the hole at slot i
+};
+
+#define MaxTimerSkip	(1 << 20) // ticks the timer is moved on by, at
+				// most, when a thread runs and there is
+				// nothing else pending (see SkipTimerTicks)
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -89,6 +138,13 @@ class Interrupt {
     void Idle(); 			// The ready queue is empty, roll 
 					// simulated time forward until the 
 					// next interrupt
+    void SetTickless(bool on) { tickless = on; }
+					// Skip the timer interrupts that
+					// would find nothing to do: in
+					// Idle, and while a thread runs
+					// under a policy without quanta
+    void SkipTimerTicks();		// Move the timer on to the first
+					// tick that may have work to do
 
     void Halt(); 			// quit and print out stats
     
@@ -106,20 +162,33 @@ class Interrupt {
     // but they need to be public since they are called by the
     // hardware device simulators.
 
-    void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
-	int arg, int when, IntType type);// at time ``when''.  This is called
+    PendingInterrupt *Schedule(VoidFunctionPtr handler,
+	int arg, int when, IntType type);// Schedule an interrupt to occur
+					// at time ``when''.  This is called
     					// by the hardware device simulators.
+    void Cancel(PendingInterrupt *toOccur);
+					// Take it off before it fires
     
     void OneTick();       		// Advance simulated time
+    void FireDue();			// Handle the interrupts that are
+					// due, without advancing time
+    void RestoreLevel(IntStatus now);	// SetLevel, without advancing
+					// time; used by SwitchCPU
+
+    int NextEventTime();		// When is the next interrupt due?
+					// -1 if none is pending
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingQueue *pending;	// the interrupts scheduled to occur
+				// in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    bool tickless;		// skip timer interrupts with nothing
+				// to do?
+    PendingInterrupt *timerInterrupt; // the timer's, while it is pending
 
     // these functions are internal to the interrupt simulation code
 
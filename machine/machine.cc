@@ -50,9 +50,12 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, run user code with the block translator
+//		rather than the instruction-at-a-time interpreter.
+//	"tlbEntries" -- the number of TLB entries, if there is a TLB.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks, int tlbEntries)
 {
     int i;
 
@@ -61,21 +64,101 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodedCache = new Instruction[MemorySize / 4];
+    decodedValid = new bool[NumPhysPages];
+    frameGeneration = new int[NumPhysPages];
+    frameBlockCount = new int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++) {
+	decodedValid[i] = FALSE;
+	frameGeneration[i] = 0;
+	frameBlockCount[i] = 0;
+    }
+    blockTable = new TranslatedBlock*[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	blockTable[i] = NULL;
 
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
+    ASSERT(tlbEntries > 0);
+    tlbSize = tlbEntries;
+    tlb = new TranslationEntry[tlbSize];
+    for (i = 0; i < tlbSize; i++)
 	tlb[i].valid = FALSE;
     pageTable = NULL;
 #else	// use linear page table
+    tlbSize = 0;
     tlb = NULL;
     pageTable = NULL;
 #endif
+    currentASID = 0;
+    bypassTLB = FALSE;
 
+    softTLB = NULL;
+    batchedTicks = 0;
+    nextEventTime = 0;
     singleStep = debug;
+    translateBlocks = blocks;
+    sharedMemory = FALSE;
+    deferTraps = FALSE;
+    trapDeferred = FALSE;
+    sharedAccess = FALSE;
+    numStores = 0;
+    numReferenced = 0;
     CheckEndian();
 }
 
+//----------------------------------------------------------------------
+// Machine::Machine
+// 	Initialize one more CPU of a multiprocessor.  It gets its own
+//	registers and TLB, but shares physical memory with "boot" -- and
+//	with it the predecoded instructions and translated blocks, so an
+//	invalidation done through any CPU is seen by all of them.
+//
+//	"boot" -- the first CPU, created with the constructor above.
+//	"tlbEntries" -- the number of TLB entries, if there is a TLB.
+//----------------------------------------------------------------------
+
+Machine::Machine(Machine *boot, int tlbEntries)
+{
+    int i;
+
+    for (i = 0; i < NumTotalRegs; i++)
+        registers[i] = 0;
+    mainMemory = boot->mainMemory;
+    decodedCache = boot->decodedCache;
+    decodedValid = boot->decodedValid;
+    frameGeneration = boot->frameGeneration;
+    frameBlockCount = boot->frameBlockCount;
+    blockTable = boot->blockTable;
+
+#ifdef USE_TLB
+    ASSERT(tlbEntries > 0);
+    tlbSize = tlbEntries;
+    tlb = new TranslationEntry[tlbSize];
+    for (i = 0; i < tlbSize; i++)
+	tlb[i].valid = FALSE;
+#else
+    tlbSize = 0;
+    tlb = NULL;
+#endif
+    pageTable = NULL;
+    pageTableSize = 0;
+    currentASID = 0;
+    bypassTLB = FALSE;
+
+    softTLB = NULL;
+    batchedTicks = 0;
+    nextEventTime = 0;
+    singleStep = boot->singleStep;
+    runUntilTime = boot->runUntilTime;
+    translateBlocks = boot->translateBlocks;
+    sharedMemory = TRUE;
+    deferTraps = FALSE;
+    trapDeferred = FALSE;
+    sharedAccess = FALSE;
+    numStores = 0;
+    numReferenced = 0;
+}
+
 //----------------------------------------------------------------------
 // Machine::~Machine
 // 	De-allocate the data structures used to simulate user program execution.
@@ -83,9 +166,19 @@ Machine::Machine(bool debug)
 
 Machine::~Machine()
 {
-    delete [] mainMemory;
     if (tlb != NULL)
         delete [] tlb;
+    if (sharedMemory)
+	return;			// the boot CPU frees the memory
+    delete [] mainMemory;
+    delete [] decodedCache;
+    delete [] decodedValid;
+    for (int i = 0; i < MemorySize / 4; i++)
+	if (blockTable[i] != NULL)
+	    delete blockTable[i];
+    delete [] blockTable;
+    delete [] frameGeneration;
+    delete [] frameBlockCount;
 }
 
 //----------------------------------------------------------------------
@@ -101,14 +194,31 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    bool nested;
+
+    if (deferTraps) {			// on a host worker: the CPU will
+	trapDeferred = TRUE;		// redo the instruction itself
+	return;
+    }
+    nested = KernelLockHeld();		// a fault taken by the kernel
+					// itself: it already holds the lock
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    FlushBatchedTicks();		// the kernel must see the exact time
     interrupt->setStatus(SystemMode);
+    if (!nested)
+	AcquireKernelLock();
     ExceptionHandler(which);		// interrupts are enabled at this point
-    interrupt->setStatus(UserMode);
+    if (!nested) {
+	ReleaseKernelLock();
+	interrupt->setStatus(UserMode);
+    }
+    machine->nextEventTime = 0;		// the kernel may have scheduled
+					// interrupts, or switched threads
+					// (even onto another CPU)
 }
 
 //----------------------------------------------------------------------
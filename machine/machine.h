@@ -40,7 +40,8 @@
 //#define NumPhysPages   512 
 #define NumPhysPages   1024 
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+#define TLBSize		4		// if there is a TLB, make it small;
+					// this is the default, -tlb changes it
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -97,6 +98,39 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// The following class describes a translated block: a run of
+// predecoded instructions, confined to one physical page, that ends
+// with a branch or jump and its delay slot.  Used by the block
+// translator (Machine::RunBlocks) in place of fetching instructions
+// one at a time.
+
+class TranslatedBlock {
+  public:
+    int physAddr;		// physical address of the first instruction
+    int length;			// number of instructions in the block
+
+    int chainPhysAddr;		// where control went after this block the
+    int chainGeneration;	//   last time, the frame generation at
+    TranslatedBlock *chain;	//   that time, and the block found there
+};
+
+// The following class describes a store to shared memory made while
+// a CPU runs on a host worker thread (Machine::RunParallel).  Other
+// CPUs must not see it until the end of the round, so it is held back
+// and done by Machine::DrainStores.  So are the CLOCK reference bits
+// the CPU sets, which are shared too.
+
+#define StoreBufferSize	64
+#define ReferenceBufferSize 64	// frames whose CLOCK reference bit a
+				// CPU on a host worker sets, likewise
+
+class BufferedStore {
+  public:
+    int physAddr;		// where to store
+    int size;			// 1, 2, or 4 bytes
+    int value;			// what to store
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -112,8 +146,15 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, bool blocks, int tlbEntries);
+				// Initialize the simulation of the hardware
+				// for running user programs; "blocks"
+				// selects the block translator, and
+				// "tlbEntries" is the size of the TLB
+    Machine(Machine *boot, int tlbEntries);
+				// Another CPU of a multiprocessor: own
+				// registers and TLB, but the memory (and
+				// its decoded copies) of "boot"
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -127,8 +168,21 @@ class Machine {
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
-    void OneInstruction(Instruction *instr); 	
+    void OneInstruction(); 	
     				// Run one instruction of a user program.
+    bool ExecuteInstruction(Instruction *instr);
+				// Execute an already decoded instruction;
+				// FALSE if it raised an exception
+    void RunBlocks();		// Run a user program a translated block
+				// at a time
+    bool AdvanceTime();		// Account for one executed user
+				// instruction; FALSE if only batched
+    void FlushBatchedTicks();	// Add the batched user ticks to stats
+    int RunParallel(int ticks);	// Run up to "ticks" worth of user
+				// instructions without the kernel;
+				// safe on a host worker thread
+    void DrainStores();		// Do the stores RunParallel held back,
+				// and set its reference bits
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -138,6 +192,12 @@ class Machine {
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
     
+    ExceptionType CachedTranslate(int virtAddr, int* physAddr, int size,
+				  bool writing);
+				// Translate through the soft TLB if it has
+				// the page, otherwise call Translate and
+				// remember the result.
+
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
 				// alignment.  Set the use and dirty bits in 
@@ -148,6 +208,23 @@ class Machine {
     int GetPA (unsigned vaddr); // Returns the physical address corresponding
                                 // to the passed virtual address.
 
+    ExceptionType KernelTranslate(int virtAddr, int* physAddr,
+				  bool writing);
+				// Translate through the page table, even
+				// if there is a TLB, paging in if needed
+    ExceptionType PageIn(int virtAddr);
+				// Bring in the page of "virtAddr" through
+				// the page table, bypassing the TLB
+    void InvalidateTLBFrame(int frame);
+				// Drop the TLB entries mapping "frame"
+    void InvalidateTLBSpace(int asid);
+				// Drop the TLB entries of an address space
+
+    void InvalidateDecodedPage(int frame);
+				// Forget the predecoded instructions of a
+				// physical frame; must be called whenever
+				// the frame is written or reassigned
+
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
@@ -188,11 +265,59 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;			// number of entries in "tlb"
+    int currentASID;			// only TLB entries tagged with this
+					// address space ID are used
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
 
+    SoftTLBEntry *softTLB;		// soft TLB of the current address
+					// space, NULL if it must not be used
+
   private:
+    TranslatedBlock *LookupBlock(int physAddr);
+				// Find or build the block at "physAddr"
+    Instruction *FetchDecoded(int physAddr);
+				// Return the predecoded instruction at
+				// "physAddr", decoding its page if needed
+
+    Instruction *decodedCache;	// one predecoded instruction per word of
+				// mainMemory, filled in a page at a time
+    bool *decodedValid;		// per physical frame: is its part of
+				// decodedCache up to date?
+
+    bool translateBlocks;	// run user code with RunBlocks?
+    TranslatedBlock **blockTable; // the block starting at each word of
+				// mainMemory, or NULL
+    int *frameGeneration;	// per frame: bumped on every invalidation
+    int *frameBlockCount;	// per frame: number of blocks in blockTable
+
+    bool sharedMemory;		// mainMemory belongs to another Machine
+
+    bool deferTraps;		// in RunParallel: stop, rather than
+				// trap, when the kernel is needed
+    bool trapDeferred;		// ... which has happened
+    bool sharedAccess;		// the last soft TLB hit was to a
+				// shared page
+    BufferedStore storeBuffer[StoreBufferSize];
+    int numStores;		// stores to shared pages held back
+    bool StorePending(int physAddr, int size);
+				// Does a held back store overlap?
+    int referencedFrame[ReferenceBufferSize];
+    int numReferenced;		// reference bits held back
+
+    bool bypassTLB;		// set by PageIn: translate through the
+				// page table even though there is a TLB
+
+    bool ReadVDSO(int addr, int size, int* value);
+				// ReadMem, for the vDSO page
+
+    int batchedTicks;		// user ticks executed but not yet added
+				// to stats (see AdvanceTime)
+    int nextEventTime;		// batch ticks only while the clock stays
+				// below this; 0 forces a full OneTick
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
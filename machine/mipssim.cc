@@ -15,6 +15,7 @@
 #include "machine.h"
 #include "mipssim.h"
 #include "system.h"
+#include "profile.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
@@ -23,6 +24,20 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 // 	Simulate the execution of a user-level program on Nachos.
 //	Called by the kernel when the program starts up; never returns.
 //
+//	If the block translator was selected (-bt), user code is run by
+//	RunBlocks instead of one OneInstruction at a time.  Single stepping
+//	and the 'm' debug trace always use the plain interpreter.
+//
+//	With more than one CPU (-ncpu), a thread that blocks in the kernel
+//	may be resumed by another CPU, so each instruction is run on
+//	whichever Machine "machine" is at the time, not on "this".  The
+//	block translator keeps too much per-Machine state for that, and
+//	is only used on a uniprocessor.
+//
+//	The host time spent here is profiled as one block per stretch of
+//	user code between two interrupts, rather than per instruction, to
+//	keep the clock reads off the interpreter's path.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //----------------------------------------------------------------------
@@ -30,17 +45,143 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    PROFILE_NAMED(userProfile, ProfUserCode);
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
+    if (KernelLockHeld())
+	ReleaseKernelLock();		// a new thread, started by the kernel
     interrupt->setStatus(UserMode);
+    nextEventTime = 0;			// whoever ran before us may have
+					// scheduled new interrupts
+    if (translateBlocks && !singleStep && !DebugIsEnabled('m')
+					&& (numCPUs == 1))
+	RunBlocks();			// never returns
     for (;;) {
-        OneInstruction(instr);
-	interrupt->OneTick();
-	if (singleStep && (runUntilTime <= stats->totalTicks))
-	  Debugger();
+        machine->OneInstruction();
+	if (machine->AdvanceTime()) {	// not just batched
+	    PROFILE_LAP(userProfile);
+	    if (machine->singleStep
+			&& (machine->runUntilTime <= stats->totalTicks))
+		machine->Debugger();
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::AdvanceTime
+// 	Account for the simulated time of one user instruction.  This
+//	does what interrupt->OneTick() would do, but in bulk: as long as
+//	the clock stays below the time of the next pending interrupt,
+//	OneTick could only add UserTick to the clock, so the ticks are
+//	just counted in "batchedTicks".  The instruction that reaches the
+//	next interrupt gets the full OneTick, after the batch is added to
+//	the statistics; so interrupts fire, and threads are preempted, at
+//	exactly the same ticks as before.
+//
+//	The kernel only runs between instructions through an interrupt
+//	(from OneTick) or an exception.  RaiseException flushes the batch
+//	before calling the handler, and both paths recompute the time of
+//	the next interrupt afterwards, so the kernel never sees a stale
+//	clock.  Batching is turned off while single stepping or tracing
+//	interrupts ('i'), whose output is per tick.
+//
+//	On a multiprocessor, interrupts are only delivered between the
+//	lockstep rounds of the CPUs (see cpu.cc), so ticks are batched up
+//	to the end of this CPU's slice of the round.  That is also where
+//	the CPU is handed over to the next one, and where a reschedule
+//	requested by the timer is honored.
+//
+//	Returns FALSE if the tick was only batched, TRUE if the clock got
+//	to an interrupt (or the end of the round), which is always the
+//	case while single stepping.
+//----------------------------------------------------------------------
+
+bool
+Machine::AdvanceTime()
+{
+    if (stats->totalTicks + batchedTicks + UserTick < nextEventTime) {
+	batchedTicks += UserTick;
+	return FALSE;
+    }
+    FlushBatchedTicks();
+    interrupt->OneTick();
+    if (numCPUs > 1) {
+	for (;;) {
+	    if (currentCPU->needResched) {
+		currentCPU->needResched = FALSE;
+		interrupt->setStatus(SystemMode);	// yield is a kernel routine
+		AcquireKernelLock();
+		currentThread->Yield();		// may resume on another CPU
+		ReleaseKernelLock();
+		interrupt->setStatus(UserMode);
+	    } else if (stats->totalTicks >= roundEnd)
+		SwitchCPU();		// returns at our next slice, which
+					// a host worker may have run already
+	    else
+		break;
+	}
+	machine->nextEventTime = (singleStep || DebugIsEnabled('i')) ? 0 : roundEnd;
+	return TRUE;
+    }
+    if (singleStep || DebugIsEnabled('i'))
+	nextEventTime = 0;
+    else
+	nextEventTime = interrupt->NextEventTime();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunParallel
+// 	Run up to "ticks" worth of user instructions of the current
+//	program, the way Run would, but without ever entering the kernel:
+//	stop, before the instruction has had any effect, as soon as one
+//	needs the kernel (an exception or system call, a soft TLB miss, a
+//	page that must be decoded, a store to a page that has been).
+//	Returns the number of ticks run; the caller adds them to the
+//	statistics, and the CPU goes on from there itself.
+//
+//	Nothing but this Machine and the physical pages it can reach
+//	through the soft TLB are written, so several CPUs can do this at
+//	once on host worker threads (see cpu.cc); the predecoded
+//	instructions they share are only read.  Stores to shared pages,
+//	and the CLOCK reference bits, are held back until DrainStores, so
+//	that what each CPU reads does not depend on how fast the others
+//	run; a load that would need one of those stores stops the run.
+//----------------------------------------------------------------------
+
+int
+Machine::RunParallel(int ticks)
+{
+    int done = 0;
+
+    if (singleStep)
+	return 0;
+    deferTraps = TRUE;
+    trapDeferred = FALSE;
+    while (done < ticks) {
+	OneInstruction();
+	if (trapDeferred)
+	    break;
+	done += UserTick;
+    }
+    deferTraps = FALSE;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushBatchedTicks
+// 	Add the user ticks batched by AdvanceTime to the statistics.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushBatchedTicks()
+{
+    if (batchedTicks > 0) {
+	stats->totalTicks += batchedTicks;
+	stats->userTicks += batchedTicks;
+	batchedTicks = 0;
     }
 }
 
@@ -79,6 +220,11 @@ TypeToReg(RegType reg, Instruction *instr)
 // 	the OS software must increment the PC so execution begins
 // 	at the instruction immediately after the syscall. 
 //
+//	The instruction is not decoded here: it is taken from the
+//	predecoded copy of its physical frame (see FetchDecoded), so a
+//	tight loop pays for Decode() once per page instead of once per
+//	executed instruction.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //	We get re-entrancy by never caching any data -- we always re-start the
@@ -91,18 +237,25 @@ TypeToReg(RegType reg, Instruction *instr)
 //----------------------------------------------------------------------
 
 void
-Machine::OneInstruction(Instruction *instr)
+Machine::OneInstruction()
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    Instruction *instr;
+    int physAddr;
+    ExceptionType exception;
 
-    // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    // Fetch instruction; every fetch is still translated (through the
+    // soft TLB) so that the use bits and the replacement bookkeeping
+    // stay exact
+    exception = CachedTranslate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    }
+    if (deferTraps && !decodedValid[physAddr / PageSize]) {
+	trapDeferred = TRUE;	// decoding writes shared state
+	return;
+    }
+    instr = FetchDecoded(physAddr);
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -114,6 +267,24 @@ Machine::OneInstruction(Instruction *instr)
        printf("\n");
        }
     
+    ExecuteInstruction(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute one already fetched and decoded instruction, at the
+//	current PC.  Returns FALSE if the instruction raised an exception
+//	(in which case the exception handler has already been run and the
+//	program counters were not advanced), TRUE otherwise.
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -127,7 +298,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -137,7 +308,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -231,8 +402,8 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LB:
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	if (!ReadMem(tmp, 1, &value))
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -247,10 +418,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
-	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	if (!ReadMem(tmp, 2, &value))
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -269,10 +440,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadMem(tmp, 4, &value))
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -285,8 +456,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadMem(tmp, 4, &value))
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -316,8 +487,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadMem(tmp, 4, &value))
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -381,15 +552,15 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SB:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -459,7 +630,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -469,9 +640,9 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SW:
-	if (!machine->WriteMem((unsigned) 
+	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -481,8 +652,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	if (!ReadMem((tmp & ~0x3), 4, &value))
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -500,8 +671,8 @@ Machine::OneInstruction(Instruction *instr)
 					    0xff);
 	    break;
 	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	if (!WriteMem((tmp & ~0x3), 4, value))
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -511,8 +682,8 @@ Machine::OneInstruction(Instruction *instr)
         // fail (I think) if the other cases are ever exercised.
 	ASSERT((tmp & 0x3) == 0);  
 
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	if (!ReadMem((tmp & ~0x3), 4, &value))
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -527,13 +698,13 @@ Machine::OneInstruction(Instruction *instr)
 	    value = registers[instr->rt];
 	    break;
 	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	if (!WriteMem((tmp & ~0x3), 4, value))
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -546,7 +717,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -562,6 +733,7 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -625,6 +797,237 @@ Instruction::Decode()
     }
 }
 
+//----------------------------------------------------------------------
+// IsControlTransfer
+// 	Return TRUE if "opCode" is a branch or jump, i.e. an instruction
+//	followed by a delay slot after which the PC may not be sequential.
+//----------------------------------------------------------------------
+
+static bool
+IsControlTransfer(int opCode)
+{
+    return ((opCode >= OP_BEQ) && (opCode <= OP_BNE)) ||
+	   ((opCode >= OP_J) && (opCode <= OP_JR));
+}
+
+//----------------------------------------------------------------------
+// Machine::LookupBlock
+// 	Return the translated block starting at physical address
+//	"physAddr", building it from the predecoded instructions of its
+//	frame if it is not cached yet.
+//
+//	A block is a run of straight-line instructions ending with a
+//	branch or jump and its delay slot.  It never crosses a page
+//	boundary and never contains a syscall or an illegal instruction;
+//	those are left to the interpreter.  Returns NULL if no block can
+//	start at "physAddr" (the caller then interprets one instruction).
+//----------------------------------------------------------------------
+
+TranslatedBlock *
+Machine::LookupBlock(int physAddr)
+{
+    TranslatedBlock *block = blockTable[physAddr / 4];
+    int frame = physAddr / PageSize;
+    int pageEnd = (frame + 1) * PageSize;
+    int length = 0;
+    Instruction *instr;
+
+    if (block != NULL)
+	return block;
+
+    for (instr = FetchDecoded(physAddr); physAddr + length * 4 < pageEnd;
+							instr++) {
+	if ((instr->opCode == OP_SYSCALL) || (instr->opCode == OP_RES) ||
+	    (instr->opCode == OP_UNIMP))
+	    break;
+	if (IsControlTransfer(instr->opCode)) {
+	    if (physAddr + (length + 1) * 4 < pageEnd)
+		length += 2;		// the branch and its delay slot
+	    break;
+	}
+	length++;
+    }
+    if (length == 0)
+	return NULL;
+
+    block = new TranslatedBlock;
+    block->physAddr = physAddr;
+    block->length = length;
+    block->chainPhysAddr = -1;
+    block->chain = NULL;
+    blockTable[physAddr / 4] = block;
+    frameBlockCount[frame]++;
+    DEBUG('b', "Translated block at physical 0x%x, %d instructions\n",
+	  physAddr, length);
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	The block translator's version of Run: execute the user program
+//	a translated block at a time.  Never returns.
+//
+//	Simulated time, UserTick accounting and the points at which
+//	interrupts and preemption happen are exactly those of the
+//	interpreter.  When the whole block ends before the next pending
+//	interrupt, AdvanceTime could only batch its ticks, so it is asked
+//	once for the block: the instructions just add their tick to
+//	"batchedTicks", which is then right at every exception or vDSO
+//	read along the way.  Otherwise (an interrupt is due inside the
+//	block, or batching is off) every instruction is followed by
+//	AdvanceTime(), as in Run.
+//
+//	The fetch translation is done once per block, since a block lives
+//	in one page.  The CLOCK reference bit is set again for every
+//	instruction only when AdvanceTime may have let another thread run
+//	(and clear it) in between.  LRU (which reorders its queue on every
+//	access) and the TLB still translate every fetch.
+//
+//	A block is abandoned as soon as an instruction raises an
+//	exception, or its frame is written or reassigned (which may
+//	happen inside OneTick, when another thread runs).  Each block
+//	remembers the block that followed it last time, so loops go from
+//	block to block without consulting blockTable.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    TranslatedBlock *block, *previous = NULL;
+    ExceptionType exception;
+    Instruction *instr;
+    int pc, physAddr, frame, generation, length, i;
+    bool exactFetch = (tlb != NULL) || (pageAlgo == LRU);
+    bool batch;				// the block ends before the next
+					// interrupt
+    PROFILE_NAMED(userProfile, ProfUserCode);
+
+    for (;;) {
+	if (batchedTicks == 0)		// an interrupt was just due
+	    PROFILE_LAP(userProfile);
+	pc = registers[PCReg];
+	exception = CachedTranslate(pc, &physAddr, 4, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, pc);
+	    AdvanceTime();
+	    previous = NULL;
+	    continue;
+	}
+	frame = physAddr / PageSize;
+
+	if ((previous != NULL) && (previous->chainPhysAddr == physAddr)
+		&& (previous->chainGeneration == frameGeneration[frame]))
+	    block = previous->chain;
+	else {
+	    block = LookupBlock(physAddr);
+	    if (previous != NULL) {
+		previous->chainPhysAddr = physAddr;
+		previous->chainGeneration = frameGeneration[frame];
+		previous->chain = block;
+	    }
+	}
+	previous = NULL;
+
+	if (block == NULL) {		// syscall or illegal instruction
+	    ExecuteInstruction(FetchDecoded(physAddr));
+	    AdvanceTime();
+	    continue;
+	}
+
+	// "block" must not be touched once the frame generation changes,
+	// it has been deleted by InvalidateDecodedPage
+	generation = frameGeneration[frame];
+	length = block->length;
+	batch = (stats->totalTicks + batchedTicks + length * UserTick
+							< nextEventTime);
+	instr = &decodedCache[physAddr / 4];
+	for (i = 0; i < length; i++, instr++) {
+	    if (i > 0) {
+		if ((frameGeneration[frame] != generation) ||
+		    (registers[PCReg] != pc + i * 4))
+		    break;		// block may be gone, back to dispatch
+		if (exactFetch) {
+		    int fetchAddr;
+
+		    exception = CachedTranslate(registers[PCReg], &fetchAddr,
+						4, FALSE);
+		    if (exception != NoException) {
+			RaiseException(exception, registers[PCReg]);
+			AdvanceTime();
+			break;
+		    }
+		    if (fetchAddr != physAddr + i * 4)
+			break;
+		} else if (!batch && (pageAlgo == LRU_CLOCK))
+		    referenceBit[frame] = 1;	// may have been cleared
+						// while another thread ran
+	    }
+	    if (!ExecuteInstruction(instr)) {
+		AdvanceTime();		// the kernel has run: not batched
+		break;
+	    }
+	    if (batch)
+		batchedTicks += UserTick;
+	    else
+		AdvanceTime();
+	}
+	if ((frameGeneration[frame] == generation) && (i == length))
+	    previous = block;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchDecoded
+// 	Return the predecoded instruction stored at physical address
+//	"physAddr".  The first fetch from a frame decodes every word of
+//	that frame; the copy stays valid until InvalidateDecodedPage
+//	is called for the frame.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::FetchDecoded(int physAddr)
+{
+    int frame = physAddr / PageSize;
+
+    if (!decodedValid[frame]) {
+	Instruction *instr = &decodedCache[frame * (PageSize / 4)];
+	unsigned int *word = (unsigned int *) &mainMemory[frame * PageSize];
+
+	for (int i = 0; i < PageSize / 4; i++, instr++, word++) {
+	    instr->value = WordToHost(*word);
+	    instr->Decode();
+	}
+	decodedValid[frame] = TRUE;
+    }
+    return &decodedCache[physAddr / 4];
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+// 	Throw away the predecoded instructions and translated blocks of
+//	physical frame "frame".
+//	Called by every piece of code that stores into mainMemory, or
+//	hands a frame over to a different virtual page.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int frame)
+{
+    ASSERT((frame >= 0) && (frame < NumPhysPages));
+    decodedValid[frame] = FALSE;
+    frameGeneration[frame]++;
+    if (frameBlockCount[frame] > 0) {	// drop the blocks built from it
+	TranslatedBlock **slot = &blockTable[frame * (PageSize / 4)];
+
+	for (int i = 0; i < PageSize / 4; i++, slot++)
+	    if (*slot != NULL) {
+		delete *slot;
+		*slot = NULL;
+	    }
+	frameBlockCount[frame] = 0;
+    }
+}
+
 //----------------------------------------------------------------------
 // Mult
 // 	Simulate R2000 multiplication.
@@ -22,6 +22,7 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numTLBHits = numTLBMisses = 0;
     
     total_wait_time = 0;
     cpu_time = 0;
@@ -32,8 +33,39 @@ Statistics::Statistics()
 
     preemptive_switch = 0;
     nonpreemptive_switch = 0;
+    numQuanta = numQuantumExpiries = 0;
+    totalQuantum = 0;
+
+    numMigrations = numSteals = numBalanceMoves = 0;
+    numBalancePasses = totalImbalance = maxImbalance = 0;
 
     burstEstimateError = 0;
+
+    for (int i = 0; i < MaxSyscalls; i++) {
+	syscallName[i] = NULL;
+	syscallCalls[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordSyscall
+// 	Note how long a system call took, once it has returned.  The
+//	call itself is counted in syscallCalls on entry, since some
+//	(Exit, Halt) never return.
+//
+//	"code" is the system call code.
+//	"ticks" is the simulated time it took.
+//	"hostNs" is the host time it took, in nanoseconds.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordSyscall(int code, int ticks, long long hostNs)
+{
+    ASSERT((code >= 0) && (code < MaxSyscalls));
+    if (ticks < 0)			// the thread came back on a CPU
+	ticks = 0;			// whose clock is behind
+    syscallTicks[code].Add(ticks);
+    syscallHostNs[code].Add(hostNs);
 }
 
 //----------------------------------------------------------------------
@@ -51,6 +83,9 @@ Statistics::Print()
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
+    if (numTLBHits + numTLBMisses > 0)
+	printf("TLB: hits %d, misses %d, hit rate %.2f%%\n", numTLBHits,
+	    numTLBMisses, 100.0 * numTLBHits / (numTLBHits + numTLBMisses));
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 
@@ -58,6 +93,88 @@ Statistics::Print()
     printf("Total CPU busy time: %d\n", cpu_time);
     printf("Non-zero CPU burst statistics: count: %d, max: %d, min: %d, mean: %.2f\n", cpu_burst_count, max_cpu_burst, min_cpu_burst, (float)cpu_time/cpu_burst_count);
     printf("Number of context switches through yield or preemption: %d, Number of non-preemptive context switches: %d\n", preemptive_switch, nonpreemptive_switch);
+    if (numQuanta > 0)
+	printf("Quanta: %d given, mean %.2f ticks, %d used up (%.2f%% of bursts)\n", numQuanta, (double)totalQuantum/numQuanta, numQuantumExpiries, (cpu_burst_count > 0) ? 100.0*numQuantumExpiries/cpu_burst_count : 0.0);
     printf("Total time for which the ready queue is empty: %d\n", empty_ready_queue_time);
-    printf("Wait time in ready queue: Total: %d, Average: %.2f\n\n", total_wait_time, (float)total_wait_time/numTotalThreads);
+    printf("Wait time in ready queue: Total: %d, Average: %.2f\n", total_wait_time, (float)total_wait_time/numTotalThreads);
+    if (numMigrations + numSteals + numBalanceMoves > 0)
+	printf("Migrations: %d, steals: %d, moved by load balancing: %d\n", numMigrations, numSteals, numBalanceMoves);
+    if (numBalancePasses > 0)
+	printf("Ready list imbalance: Average: %.2f, Max: %d (over %d balancing passes)\n", (float)totalImbalance/numBalancePasses, maxImbalance, numBalancePasses);
+    printf("\n");
+
+    for (int i = 0; i < MaxSyscalls; i++) {
+	if (syscallCalls[i] == 0)
+	    continue;
+	printf("System call %s: calls %d", (syscallName[i] != NULL)
+		? syscallName[i] : "?", syscallCalls[i]);
+	if (syscallTicks[i].count > 0)
+	    printf(", ticks: mean %.2f, max %lld; host ns: mean %.0f, max %lld",
+		(double)syscallTicks[i].total / syscallTicks[i].count,
+		syscallTicks[i].max,
+		(double)syscallHostNs[i].total / syscallHostNs[i].count,
+		syscallHostNs[i].max);
+	printf("\n");
+	syscallTicks[i].Print("ticks");
+	syscallHostNs[i].Print("host ns");
+    }
+}
+
+//----------------------------------------------------------------------
+// Histogram::Histogram
+// 	Initialize a histogram to empty.
+//----------------------------------------------------------------------
+
+Histogram::Histogram()
+{
+    count = 0;
+    total = max = 0;
+    for (int i = 0; i < HistogramBuckets; i++)
+	bucket[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Add
+// 	Count one more value, which must not be negative.
+//----------------------------------------------------------------------
+
+void
+Histogram::Add(long long value)
+{
+    int i = 0;
+
+    ASSERT(value >= 0);
+    count++;
+    total += value;
+    if (value > max)
+	max = value;
+    while ((value > 0) && (i < HistogramBuckets - 1)) {
+	value >>= 1;
+	i++;
+    }
+    bucket[i]++;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Print
+// 	Print the non-empty buckets on one line, each as the range of
+//	values it counts and how many there were.
+//----------------------------------------------------------------------
+
+void
+Histogram::Print(char *label)
+{
+    if (count == 0)
+	return;
+    printf("    %s:", label);
+    for (int i = 0; i < HistogramBuckets; i++) {
+	if (bucket[i] == 0)
+	    continue;
+	if (i == 0)
+	    printf(" [0] %d", bucket[i]);
+	else
+	    printf(" [%lld-%lld] %d", 1LL << (i - 1), (1LL << i) - 1,
+		   bucket[i]);
+    }
+    printf("\n");
 }
@@ -13,6 +13,29 @@
 
 #include "copyright.h"
 
+#define MaxSyscalls	32	// system call codes we keep statistics for
+#define HistogramBuckets 40	// enough for host times of minutes
+
+// The following class defines a histogram of values spread over
+// powers of two: bucket 0 counts the zeros, and bucket i > 0 the
+// values from 2^(i-1) to 2^i - 1.  The last bucket also counts
+// everything larger.
+
+class Histogram {
+  public:
+    Histogram();			// initialize everything to zero
+
+    void Add(long long value);		// count one more value
+    void Print(char *label);		// print the non-empty buckets
+
+    int count;				// values added
+    long long total;			// their sum
+    long long max;			// the largest one
+
+  private:
+    int bucket[HistogramBuckets];
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -38,6 +61,19 @@ class Statistics {
 
     int preemptive_switch;	// Preemptive context switch count
     int nonpreemptive_switch;	// Non-preemptive context switch count
+    int numQuanta;		// Quanta given out by dispatches
+    long long totalQuantum;	// Sum of their lengths
+    int numQuantumExpiries;	// Bursts ended because the quantum was up
+
+    int numMigrations;		// Dispatches onto another CPU than the
+				// thread last ran on
+    int numSteals;		// Threads taken from another CPU's ready list
+    int numBalanceMoves;	// Threads moved by load balancing
+    int numBalancePasses;	// Load balancing passes
+    int totalImbalance;		// Sum over the passes of the difference
+				// between the longest and the shortest
+				// per-CPU ready list
+    int maxImbalance;		// Largest such difference
 
     int numTotalThreads;	// Total number of created threads
 
@@ -48,11 +84,23 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numTLBHits;		// number of translations found in the TLB
+    int numTLBMisses;		// number of TLB misses (refills)
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
+    char *syscallName[MaxSyscalls];	// set by the kernel, NULL if unused
+    int syscallCalls[MaxSyscalls];	// times each system call was made
+    Histogram syscallTicks[MaxSyscalls];
+				// simulated ticks from the call to the
+				// return to user mode, blocking included
+    Histogram syscallHostNs[MaxSyscalls];
+				// host nanoseconds over the same span
+
     Statistics(); 		// initialize everything to zero
 
+    void RecordSyscall(int code, int ticks, long long hostNs);
+				// a system call has returned
     void Print();		// print collected statistics
 };
 
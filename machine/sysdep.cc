@@ -45,6 +45,8 @@ extern "C" {
 #include <unistd.h>    // for getpagesize()
 #include <stdlib.h>    // for exit()
 #include <errno.h>
+#include <pthread.h>   // for the host worker threads
+#include <time.h>      // for clock_gettime()
 
 
 // UNIX routines called by procedures in this file 
@@ -407,6 +409,41 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// HostNanoseconds
+// 	Return the time on the host's monotonic clock, in nanoseconds,
+//	for measuring how long Nachos itself takes to do something.
+//----------------------------------------------------------------------
+
+long long
+HostNanoseconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//----------------------------------------------------------------------
+// HostCycles
+// 	Return the host's cycle counter, which is much cheaper to read
+//	than the clock, for timing short stretches of code.  Where there
+//	is none we know of, fall back on HostNanoseconds.
+//----------------------------------------------------------------------
+
+long long
+HostCycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int low, high;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+    return ((long long) high << 32) | low;
+#else
+    return HostNanoseconds();
+#endif
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -492,3 +529,109 @@ DeallocBoundedArray(char *ptr, int size)
     mprotect(ptr + size, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
     delete [] (ptr - pgSize);
 }
+
+//----------------------------------------------------------------------
+// Host worker threads
+// 	A pool of host threads that run a set of independent jobs in
+//	parallel: RunOnHostWorkers calls (*func)(i) for every i from 0
+//	to count-1, on the workers and on the calling thread, and returns
+//	when all of the calls have returned.  The jobs must not touch any
+//	Nachos state they share, nor call into the kernel; the simulator
+//	uses this only to run the user code of several simulated CPUs at
+//	once (see cpu.cc).
+//
+//	With a single worker (the default), the jobs are simply run one
+//	after the other by the caller.
+//----------------------------------------------------------------------
+
+static int numHostWorkers = 1;
+static pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+static VoidFunctionPtr workFunc;	// the jobs of the current batch
+static int workCount;			// how many jobs there are
+static int workNext;			// the next one nobody has taken
+static int workPending;			// how many have not yet returned
+static int workBatch;			// bumped for every new batch
+
+//----------------------------------------------------------------------
+// RunJobs
+// 	Take jobs of the current batch until there are none left.  Called
+//	and returns with workLock held.
+//----------------------------------------------------------------------
+
+static void
+RunJobs()
+{
+    while (workNext < workCount) {
+	int job = workNext++;
+
+	pthread_mutex_unlock(&workLock);
+	(*workFunc)(job);
+	pthread_mutex_lock(&workLock);
+	if (--workPending == 0)
+	    pthread_cond_signal(&workDone);
+    }
+}
+
+//----------------------------------------------------------------------
+// HostWorkerMain
+// 	The body of a host worker thread: wait for a batch, help run it.
+//----------------------------------------------------------------------
+
+static void *
+HostWorkerMain(void *dummy)
+{
+    int seen = 0;
+
+    pthread_mutex_lock(&workLock);
+    for (;;) {
+	while (workBatch == seen)
+	    pthread_cond_wait(&workReady, &workLock);
+	seen = workBatch;
+	RunJobs();
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// StartHostWorkers
+// 	Create the pool, for "n" jobs at a time (counting the caller).
+//----------------------------------------------------------------------
+
+void
+StartHostWorkers(int n)
+{
+    pthread_t worker;
+
+    for (numHostWorkers = 1; numHostWorkers < n; numHostWorkers++)
+	if (pthread_create(&worker, NULL, HostWorkerMain, NULL) != 0)
+	    break;			// make do with what we have
+}
+
+//----------------------------------------------------------------------
+// RunOnHostWorkers
+// 	Call (*func)(i) for 0 <= i < count, in parallel when there are
+//	workers, and return when all of the calls are done.
+//----------------------------------------------------------------------
+
+void
+RunOnHostWorkers(VoidFunctionPtr func, int count)
+{
+    if ((numHostWorkers == 1) || (count == 1)) {
+	for (int i = 0; i < count; i++)
+	    (*func)(i);
+	return;
+    }
+    pthread_mutex_lock(&workLock);
+    workFunc = func;
+    workCount = count;
+    workNext = 0;
+    workPending = count;
+    workBatch++;
+    pthread_cond_broadcast(&workReady);
+    RunJobs();
+    while (workPending > 0)
+	pthread_cond_wait(&workDone, &workLock);
+    pthread_mutex_unlock(&workLock);
+}
@@ -42,6 +42,8 @@ extern void SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
 extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
+extern long long HostNanoseconds();	// host clock, for profiling
+extern long long HostCycles();		// cheaper, in host clock cycles
 
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
@@ -55,6 +57,10 @@ extern int Random();
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(char *p, int size);
 
+// Run independent jobs in parallel on host threads
+extern void StartHostWorkers(int n);
+extern void RunOnHostWorkers(VoidFunctionPtr func, int count);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
@@ -39,6 +39,9 @@ class Timer {
     int TimeOfNextInterrupt();  // figure out when the timer will generate
 				// its next interrupt 
 
+    bool IsPeriodic() { return !randomize; }
+				// does it interrupt every TimerTicks?
+
   private:
     bool randomize;		// set if we need to use a random timeout delay
     VoidFunctionPtr handler;	// timer interrupt handler 
@@ -33,7 +33,10 @@
 #include "copyright.h"
 #include "machine.h"
 #include "addrspace.h"
+#include "syscall.h"
 #include "system.h"
+#include "trace.h"
+#include "profile.h"
 #include "filesys.h"
 
 // Routines for converting Words and Short Words to and from the
@@ -73,7 +76,35 @@ unsigned short
 ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
 extern int* getLRUClockFrame();
-extern void printQueue();
+extern void TraceQueueContents();
+
+//----------------------------------------------------------------------
+// StorePhysical
+// 	Store "size" (1, 2, or 4) bytes of "value" at physical address
+//	"physAddr" of "memory", in the simulated machine's byte order.
+//----------------------------------------------------------------------
+
+static void
+StorePhysical(char *memory, int physAddr, int size, int value)
+{
+    switch (size) {
+      case 1:
+	memory[physAddr] = (unsigned char) (value & 0xff);
+	break;
+
+      case 2:
+	*(unsigned short *) &memory[physAddr]
+		= ShortToMachine((unsigned short) (value & 0xffff));
+	break;
+      
+      case 4:
+	*(unsigned int *) &memory[physAddr]
+		= WordToMachine((unsigned int) value);
+	break;
+	
+      default: ASSERT(FALSE);
+    }
+}
 
 //----------------------------------------------------------------------
 // Machine::ReadMem
@@ -97,24 +128,30 @@ Machine::ReadMem(int addr, int size, int *value)
     
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
+    if (((unsigned) addr / PageSize) == (VDSO_ADDR / PageSize))
+	return ReadVDSO(addr, size, value);
+    exception = CachedTranslate(addr, &physicalAddress, size, FALSE);
     if (exception != NoException) {
-	machine->RaiseException(exception, addr);
+	RaiseException(exception, addr);
+	return FALSE;
+    }
+    if (deferTraps && sharedAccess && StorePending(physicalAddress, size)) {
+	trapDeferred = TRUE;		// see RunParallel
 	return FALSE;
     }
     switch (size) {
       case 1:
-	data = machine->mainMemory[physicalAddress];
+	data = mainMemory[physicalAddress];
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned short *) &mainMemory[physicalAddress];
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
+	data = *(unsigned int *) &mainMemory[physicalAddress];
 	*value = WordToHost(data);
 	break;
 
@@ -146,32 +183,197 @@ Machine::WriteMem(int addr, int size, int value)
      
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
+    if (((unsigned) addr / PageSize) == (VDSO_ADDR / PageSize)) {
+	RaiseException(ReadOnlyException, addr);	// the vDSO page
+	return FALSE;
+    }
+    exception = CachedTranslate(addr, &physicalAddress, size, TRUE);
     if (exception != NoException) {
-	machine->RaiseException(exception, addr);
+	RaiseException(exception, addr);
 	return FALSE;
     }
+    if (deferTraps && sharedAccess) {	// see RunParallel
+	if (numStores == StoreBufferSize) {
+	    trapDeferred = TRUE;
+	    return FALSE;
+	}
+	storeBuffer[numStores].physAddr = physicalAddress;
+	storeBuffer[numStores].size = size;
+	storeBuffer[numStores].value = value;
+	numStores++;
+	return TRUE;
+    }
+    if (deferTraps) {
+	if (decodedValid[physicalAddress / PageSize]) {
+	    trapDeferred = TRUE;	// invalidating writes shared state
+	    return FALSE;
+	}
+	StorePhysical(mainMemory, physicalAddress, size, value);
+	return TRUE;			// nothing was decoded from it
+    }
+    StorePhysical(mainMemory, physicalAddress, size, value);
+    InvalidateDecodedPage(physicalAddress / PageSize);
+    
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::ReadVDSO
+//      ReadMem for an address in the vDSO page (see syscall.h), which
+//	is mapped read-only into every address space without taking up
+//	a frame or a page table entry.  The kernel keeps the page up to
+//	date; here that is done by filling it in as it is read, from the
+//	clock and the thread running on this CPU.
+//
+//	Not done on a host worker (RunParallel), where the clock and the
+//	current thread are those of another CPU.
+//----------------------------------------------------------------------
+
+bool
+Machine::ReadVDSO(int addr, int size, int *value)
+{
+    unsigned int page[VDSO_SIZE / 4];
+    int offset = (unsigned) addr % PageSize;
+    int data;
+
+    if (deferTraps) {
+	trapDeferred = TRUE;
+	return FALSE;
+    }
+    if (((size == 4) && (addr & 0x3)) || ((size == 2) && (addr & 0x1))) {
+	RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (offset + size > VDSO_SIZE) {	// the rest of the page is zero
+	*value = 0;
+	return TRUE;
+    }
+
+    page[VDSO_TICKS / 4] = WordToMachine(stats->totalTicks + batchedTicks);
+    page[VDSO_PID / 4] = WordToMachine(currentThread->GetPID());
+    page[VDSO_PPID / 4] = WordToMachine(currentThread->GetPPID());
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	data = ((char *) page)[offset];
+	*value = data;
 	break;
 
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
+	data = *(unsigned short *) ((char *) page + offset);
+	*value = ShortToHost(data);
 	break;
-      
+
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	data = *(unsigned int *) ((char *) page + offset);
+	*value = WordToHost(data);
 	break;
-	
+
       default: ASSERT(FALSE);
     }
-    
+    DEBUG('a', "	vDSO value read = %8.8x\n", *value);
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::StorePending
+// 	Does a store held back by RunParallel overlap the "size" bytes
+//	at physical address "physAddr"?
+//----------------------------------------------------------------------
+
+bool
+Machine::StorePending(int physAddr, int size)
+{
+    for (int i = 0; i < numStores; i++)
+	if ((storeBuffer[i].physAddr < physAddr + size)
+		&& (physAddr < storeBuffer[i].physAddr + storeBuffer[i].size))
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::DrainStores
+// 	Do the stores to shared pages that RunParallel held back, in
+//	the order they were made, and set the reference bits it held
+//	back.  Called between rounds, one CPU after the other.
+//----------------------------------------------------------------------
+
+void
+Machine::DrainStores()
+{
+    for (int i = 0; i < numReferenced; i++)
+	referenceBit[referencedFrame[i]] = 1;
+    numReferenced = 0;
+    for (int i = 0; i < numStores; i++) {
+	StorePhysical(mainMemory, storeBuffer[i].physAddr,
+		      storeBuffer[i].size, storeBuffer[i].value);
+	InvalidateDecodedPage(storeBuffer[i].physAddr / PageSize);
+    }
+    numStores = 0;
+}
+
+//----------------------------------------------------------------------
+// Machine::CachedTranslate
+// 	Translate a virtual address into a physical address, like
+//	Translate, but try the soft TLB of the current address space
+//	first.  A hit costs an index, a compare and an alignment check.
+//	On a miss (or a store to a page not yet known to be dirty) the
+//	full Translate is done and, if it succeeded, its result is
+//	entered in the soft TLB.
+//
+//	The use bit of a cached page is already set, and stays set, so a
+//	hit needs only to set the CLOCK reference bit (on a host worker,
+//	to note it for DrainStores).  The soft TLB is
+//	never used with LRU, whose queue must be updated on every access,
+//	nor with the hardware TLB.
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::CachedTranslate(int virtAddr, int* physAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    SoftTLBEntry *slot;
+    ExceptionType exception;
+
+    if ((softTLB == NULL) || (tlb != NULL)) {
+        if (deferTraps)			// Translate updates kernel state
+            return PageFaultException;	// (RunParallel stops)
+        return Translate(virtAddr, physAddr, size, writing);
+    }
+
+    slot = &softTLB[vpn & (SoftTLBSize - 1)];
+    if ((slot->virtualPage == (int) vpn) && !(virtAddr & (size - 1))
+            && (!writing || slot->writable)) {
+        *physAddr = slot->physicalBase + (unsigned) virtAddr % PageSize;
+        sharedAccess = slot->shared;
+        if (pageAlgo == LRU_CLOCK) {
+            int frame = slot->physicalBase / PageSize;
+
+            if (!deferTraps)
+                referenceBit[frame] = 1;
+            else if ((numReferenced == 0)
+                    || (referencedFrame[numReferenced - 1] != frame)) {
+                if (numReferenced == ReferenceBufferSize)
+                    return PageFaultException;	// RunParallel stops
+                referencedFrame[numReferenced++] = frame;
+            }
+        }
+        return NoException;
+    }
+    if (deferTraps)
+        return PageFaultException;
+
+    exception = Translate(virtAddr, physAddr, size, writing);
+    if (exception == NoException) {
+        TranslationEntry *entry = &pageTable[vpn];
+
+        slot->virtualPage = vpn;
+        slot->physicalBase = entry->physicalPage * PageSize;
+        slot->writable = entry->dirty && !entry->readOnly;
+        slot->shared = entry->shared;
+    }
+    return exception;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -197,8 +399,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     int flag = 0;
     unsigned int numPages = currentThread->space->GetNumPages();
     unsigned int StartMachine, StartBackup;
-
-    DEBUG('a', "\tTranslate 0x%x, %s: \n\t", virtAddr, writing ? "write" : "read");
+    PROFILE(ProfTranslate);
 
     // check for alignment errors
     if (((size == 4) && (virtAddr & 0x3)) || ((size == 2) && (virtAddr & 0x1))){
@@ -206,8 +407,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
         return AddressErrorException;
     }
 
-    // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || pageTable == NULL);	
+    // we must have either a TLB or a page table.  If there is a TLB, the
+    // page table is only used by the kernel to refill it (and by PageIn)
     ASSERT(tlb != NULL || pageTable != NULL);	
 
     // calculate the virtual page number, and offset within the page,
@@ -215,7 +416,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
 
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    if ((tlb == NULL) || bypassTLB) {	// => page table => vpn is index into table
         if (vpn >= pageTableSize) {
             DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
                     virtAddr, pageTableSize);
@@ -240,6 +441,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
             if(numPagesAllocated == NumPhysPages) {
                 // here we have to handle page replacement
+                PROFILE(ProfReplacement);
                 DEBUG('R', "\nInvoking page replacement algorithm: ");
 
                 // The frame which will be replace
@@ -267,6 +469,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
                 // We have to delete the frameToReplace
                 delete frameToReplace;
+                TRACE(TracePaging, TR_EVICT, frameEntry->physicalPage,
+                      frameEntry->threadPid);
 
                 DEBUG('R', "\n\tvirtual %d physical %d thread %d shared %d valid %d", 
                         frameEntry->virtualPage, frameEntry->physicalPage, 
@@ -276,6 +480,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
                 // Now this page should no longer be valid
                 frameEntry->valid = FALSE;
                 thread->space->validPages--;
+                thread->space->FlushSoftTLBPage(frameEntry->virtualPage);
+                ShootdownTLBFrame(frameEntry->physicalPage);
 
                 // Now we have to copy the values between the backupMemory and
                 // machineMemory in case the page is dirty
@@ -289,11 +495,10 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
                     // Now we have to copy the mainMemory to backupMemory
                     StartMachine = frameEntry->physicalPage * PageSize;
                     StartBackup = frameEntry->virtualPage * PageSize;
-                    for(j=0; j<PageSize; j++) {
-                        thread->backupMemory[StartBackup+j] = machine->mainMemory[StartMachine+j];
-                        DEBUG('r', "B: %d\n", thread->backupMemory[StartBackup+j]);
-                        DEBUG('r', "M: %d\n", machine->mainMemory[StartMachine+j]);
-                    }
+                    bcopy(&machine->mainMemory[StartMachine],
+                          &thread->backupMemory[StartBackup], PageSize);
+                    TRACE(TracePaging, TR_WRITE_BACK, frameEntry->virtualPage,
+                          frameEntry->threadPid);
                 }
 
                 // Now we have to change the pageframe of entry
@@ -322,16 +527,20 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
             pageFrame = entry->physicalPage;
 
             DEBUG('A', "Allocating physical page %d VPN %d virtualaddress %d\n", pageFrame, vpn, virtAddr);
+            TRACE(TracePaging, TR_PAGE_FAULT, vpn, pageFrame);
 
             // In case of FIFO or LRU_CLOCK we maintain a fifo queue of elements
             if(pageAlgo == FIFO) {
                 int *temp = new int(pageFrame);
                 pageQueue->Append((void *)temp);
-                DEBUG('Q', "FIFO Update ");
-                printQueue();
+                if (Tracing(TraceQueue)) {
+                    TraceEvent(TR_QUEUE_APPEND, pageFrame, 0);
+                    TraceQueueContents();
+                }
             }
 
             if(pageAlgo == LRU_CLOCK){
+                PROFILE(ProfReplacement);
                 deleteFromPageQueue(pageFrame);
                 int *temp = new int(pageFrame);
                 pageQueue->Append((void *)temp);
@@ -339,16 +548,19 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
                 // If this is the first page fault then we set the LRU_CLOCK
                 // hand
                 if(stats->numPageFaults == 0) {
-                    DEBUG('q', "Setting the LRU_CLOCK Hand to %d\n", *temp);
                     LRUClockhand = new int(*temp);
                 }
 
-                DEBUG('Q', "LRU_CLK List \t ");
-                printQueue();
+                if (Tracing(TraceQueue)) {
+                    TraceEvent(TR_QUEUE_APPEND, pageFrame, 0);
+                    TraceQueueContents();
+                }
             }
 
-            // zero out this particular page
+            // zero out this particular page, the old contents of the frame
+            // must not be executed from the decode cache either
             bzero(&machine->mainMemory[pageFrame*PageSize], PageSize);
+            InvalidateDecodedPage(pageFrame);
 
             // Now here are two cases, we may either have to use the
             // backupMemory of the thread or the mainMemory
@@ -363,6 +575,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
                 }
             } else {
                 // Now copy the corresponding area from memory
+                PROFILE(ProfDiskIO);
                 if( vpn == (numPages - 1) ) {
                     readSize = size - vpn * PageSize;
                 }
@@ -390,17 +603,20 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
             return PageFaultException;
         }
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-            if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
+        for (entry = NULL, i = 0; i < tlbSize; i++)
+            if (tlb[i].valid && (tlb[i].virtualPage == vpn)
+                    && (tlb[i].asid == currentASID)) {
                 entry = &tlb[i];			// FOUND!
                 break;
             }
         if (entry == NULL) {				// not found
-            DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+            TRACE(TraceMemory, TR_TLB_MISS, vpn, currentASID);
+            stats->numTLBMisses++;
             return PageFaultException;		// really, this is a TLB fault,
             // the page may be in memory,
             // but not in the TLB
         }
+        stats->numTLBHits++;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -420,10 +636,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
         entry->dirty = TRUE;
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
-    DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+    TRACE(TraceMemory, TR_TRANSLATE, virtAddr, *physAddr);
 
     // A new frame is updated so ww change the LRU pageQueue
     if(pageAlgo == LRU) {
+        PROFILE(ProfReplacement);
+
         // First of all we delete the element if it's in the queue
         deleteFromPageQueue(pageFrame);
 
@@ -431,19 +649,87 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
         // pop, we pop from the head so this is the same as LRU
         int *temp = new int(pageFrame);
         pageQueue->Append((void *)temp);
-        DEBUG('Q', "LRU Update %d\t", pageFrame);
-        printQueue();
+        if (Tracing(TraceQueue)) {
+            TraceEvent(TR_QUEUE_APPEND, pageFrame, 0);
+            TraceQueueContents();
+        }
     } else if (pageAlgo == LRU_CLOCK) {
         // We have to set the reference bit of the element if it's not set and
         // let it remain the same if it's set
         referenceBit[pageFrame] = 1;
-        DEBUG('Q', "LRU_C Update %d\t", pageFrame);
-        printQueue();
+        if (Tracing(TraceQueue)) {
+            TraceEvent(TR_QUEUE_REF, pageFrame, 0);
+            TraceQueueContents();
+        }
     }
 
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// Machine::KernelTranslate
+// 	Translate "virtAddr" through the page table, even though there may
+//	be a TLB, for the kernel to get at user memory.  If the page is
+//	not in memory, Translate brings it in and returns
+//	PageFaultException; the caller is to try again.
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::KernelTranslate(int virtAddr, int* physAddr, bool writing)
+{
+    ExceptionType exception;
+
+    ASSERT(pageTable != NULL);
+    bypassTLB = TRUE;
+    exception = Translate(virtAddr, physAddr, 1, writing);
+    bypassTLB = FALSE;
+    return exception;
+}
+
+//----------------------------------------------------------------------
+// Machine::PageIn
+// 	Translate "virtAddr" through the page table, even though there is
+//	a TLB.  Used by the TLB miss handler when the page table entry is
+//	not valid, to run the demand paging code of Translate.  Returns
+//	what Translate returned.
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::PageIn(int virtAddr)
+{
+    int physAddr;
+
+    return KernelTranslate(virtAddr, &physAddr, FALSE);
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateTLBFrame
+// 	Drop every TLB entry, of any address space, that maps physical
+//	page "frame".  Called when the frame is given to another page.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateTLBFrame(int frame)
+{
+    for (int i = 0; i < tlbSize; i++)
+        if (tlb[i].valid && (tlb[i].physicalPage == frame))
+            tlb[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateTLBSpace
+// 	Drop every TLB entry tagged with address space ID "asid".  Called
+//	when the address space gives up its pages.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateTLBSpace(int asid)
+{
+    for (int i = 0; i < tlbSize; i++)
+        if (tlb[i].valid && (tlb[i].asid == asid))
+            tlb[i].valid = FALSE;
+}
+
 //----------------------------------------------------------------------
 // Machine::GetPA
 //      Returns the physical address corresponding to the passed virtual
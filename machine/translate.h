@@ -45,6 +45,27 @@ class TranslationEntry {
     bool cached; // To copy from the cache rather than the executable
 
     int threadPid; // The thread to which this pageTable belongs to
+
+    int asid;		// TLB entries only: the address space the
+			// translation belongs to, so that the TLB need
+			// not be flushed on a context switch
+};
+
+// The following class defines an entry in the soft TLB: a small,
+// direct-mapped cache of the translations of one address space, kept
+// in front of Machine::Translate.  A hit gives the physical address of
+// the page without going through the page table.  "writable" is only
+// set once the page is already dirty, so the first store to a page
+// still goes through Translate and sets the dirty bit.
+
+#define SoftTLBSize	64	// number of entries; must be a power of 2
+
+class SoftTLBEntry {
+  public:
+    int virtualPage;	// The cached virtual page, or -1 if empty.
+    int physicalBase;	// Offset of the page in "mainMemory".
+    bool writable;	// Can stores hit this entry?
+    bool shared;	// Is the page shared with other address spaces?
 };
 
 #endif
@@ -0,0 +1,69 @@
+/* blocktest.c
+ *	Exercise the block translator.  Run it twice,
+ *
+ *		nachos -x ../test/blocktest
+ *		nachos -bt -x ../test/blocktest
+ *
+ *	and compare the two outputs: the checksums, the register dump and
+ *	the tick counts printed at halt must be identical.  "make checkbt"
+ *	does that, for this program and a few others.
+ */
+
+#include "syscall.h"
+
+#define SIZE 64
+
+int data[SIZE];
+char bytes[SIZE];
+short halves[SIZE];
+
+int
+mix(int a, int b)
+{
+    if (a & 1) return (a * 31) ^ b;
+    else return (a / 3) - (b >> 2);
+}
+
+int
+main()
+{
+    int i, j, sum = 0, prod = 1;
+    unsigned u = 0xdeadbeef;
+
+    for (i = 0; i < SIZE; i++) {
+        data[i] = i * i - 7;
+        bytes[i] = (char)(i * 13);
+        halves[i] = (short)(i * 1021);
+    }
+    for (j = 0; j < 50; j++) {
+        for (i = 0; i < SIZE; i++) {
+            sum += mix(data[i], j) + bytes[i] + halves[i];
+            data[i] ^= sum;
+            if (sum < 0) prod = prod * 3 + 1;
+            else prod = prod % 1000003;
+            u = (u >> 3) | (u << 29);
+        }
+    }
+
+    PrintString("sum: ");
+    PrintInt(sum);
+    PrintString("\nprod: ");
+    PrintInt(prod);
+    PrintString("\nrot: ");
+    PrintIntHex(u);
+    PrintChar('\n');
+    for (i = 0; i < 32; i++) {
+        PrintString("r");
+        PrintInt(i);
+        PrintString(" = ");
+        PrintIntHex(GetReg(i));
+        PrintChar('\n');
+    }
+    PrintString("pc = ");
+    PrintIntHex(GetReg(34));
+    PrintString("\ntime = ");
+    PrintInt(GetTime());
+    PrintChar('\n');
+    Exit(0);
+    return 0;
+}
@@ -0,0 +1,44 @@
+/* ringtest.c
+ *	Simple program to test system call rings: print a few lines and
+ *	take the time with one Submit, instead of one trap per call.
+ */
+
+#include "syscall.h"
+
+#define ENTRIES	8
+
+int
+main()
+{
+    int space[3 + ENTRIES * 5];		/* a Ring with ENTRIES entries */
+    Ring *ring = (Ring *)space;
+    RingEntry *entry;
+    int i;
+
+    if (RingSetup(ring, ENTRIES) < 0) {
+       PrintString("RingSetup failed\n");
+       return 1;
+    }
+
+    for (i = 0; i < 3; i++) {
+       entry = &ring->entries[ring->tail % ENTRIES];
+       entry->code = SC_PrintString;
+       entry->arg[0] = (int)"hello from the ring\n";
+       ring->tail++;
+       entry = &ring->entries[ring->tail % ENTRIES];
+       entry->code = SC_PrintInt;
+       entry->arg[0] = i;
+       ring->tail++;
+    }
+    entry = &ring->entries[ring->tail % ENTRIES];
+    entry->code = SC_Time;
+    ring->tail++;
+
+    PrintInt(Submit(1));
+    PrintString(" requests, done: ");
+    PrintInt(ring->done);
+    PrintString(", time: ");
+    PrintInt(entry->result);
+    PrintChar('\n');
+    return 0;
+}
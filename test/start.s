@@ -178,19 +178,23 @@ GetPA:
 	j       $31
 	.end GetPA
 
+/* GetPID, GetPPID and GetTime read the vDSO page (see syscall.h)
+ * instead of trapping; SC_GetPID, SC_GetPPID and SC_Time still work.
+ */
+
 	.globl GetPID
 	.ent    GetPID
 GetPID:
-	addiu $2,$0,SC_GetPID
-	syscall
+	lui	$2,VDSO_ADDR>>16
+	lw	$2,VDSO_PID($2)
 	j       $31
 	.end GetPID
 
 	.globl GetPPID
 	.ent    GetPPID
 GetPPID:
-	addiu $2,$0,SC_GetPPID
-	syscall
+	lui	$2,VDSO_ADDR>>16
+	lw	$2,VDSO_PPID($2)
 	j       $31
 	.end GetPPID
 
@@ -205,8 +209,8 @@ Sleep:
 	.globl GetTime
 	.ent    GetTime
 GetTime:
-	addiu $2,$0,SC_Time
-	syscall
+	lui	$2,VDSO_ADDR>>16
+	lw	$2,VDSO_TICKS($2)
 	j       $31
 	.end GetTime
 
@@ -266,6 +270,22 @@ ShmAllocate:
 	j       $31
 	.end ShmAllocate
 
+	.globl RingSetup
+	.ent    RingSetup
+RingSetup:
+	addiu $2,$0,SC_RingSetup
+	syscall
+	j       $31
+	.end RingSetup
+
+	.globl Submit
+	.ent    Submit
+Submit:
+	addiu $2,$0,SC_Submit
+	syscall
+	j       $31
+	.end Submit
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -237,6 +237,27 @@ List::SortedRemove(int *keyPtr)
     return thing;
 }
 
+//----------------------------------------------------------------------
+// List::SortedPeek
+//      Return the first "item" of a sorted list, without removing it.
+//      Unlike a SortedRemove followed by a SortedInsert, this does not
+//      move the item behind other items with the same key.
+// 
+// Returns:
+//	Pointer to the first item, NULL if nothing on the list.
+//	Sets *keyPtr to the priority value of that item.
+//----------------------------------------------------------------------
+
+void *
+List::SortedPeek(int *keyPtr)
+{
+    if (IsEmpty()) 
+	return NULL;
+    if (keyPtr != NULL)
+        *keyPtr = first->key;
+    return first->item;
+}
+
 void*
 List::GetMinPriorityThread (void)
 {
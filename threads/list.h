@@ -57,6 +57,8 @@ class List {
     // Routines to put/get items on/off list in order (sorted by key)
     void SortedInsert(void *item, int sortKey);	// Put item into list
     void *SortedRemove(int *keyPtr); 	  	// Remove first item from list
+    void *SortedPeek(int *keyPtr);		// Look at first item, leave
+						// it on the list
 
     void *GetMinPriorityThread (void);
 
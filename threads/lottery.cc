@@ -0,0 +1,200 @@
+// lottery.cc
+//	Routines to manage a set of threads holding lottery tickets.  See
+//	lottery.h.
+//
+//	These routines assume that interrupts are already disabled, as
+//	the scheduler's do.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "lottery.h"
+
+//----------------------------------------------------------------------
+// LotteryTree::LotteryTree, LotteryTree::~LotteryTree
+// 	Initialize an empty set; de-allocate it.  The threads still in
+//	it, if any, are not de-allocated.
+//----------------------------------------------------------------------
+
+LotteryTree::LotteryTree()
+{
+    room = InitialLotterySize;
+    owner = new Thread*[room];
+    tickets = new int[room];
+    tree = new int[room + 1];
+    freeSlots = new int[room];
+    for (int i = 0; i <= room; i++)
+	tree[i] = 0;
+    numFree = 0;
+    used = 0;
+    size = 0;
+    total = 0;
+}
+
+LotteryTree::~LotteryTree()
+{
+    for (int i = 0; i < used; i++)
+	if (owner[i] != NULL)
+	    owner[i]->lotterySlot = -1;
+    delete [] owner;
+    delete [] tickets;
+    delete [] tree;
+    delete [] freeSlots;
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Add
+// 	The tickets of "slot" go up by "delta" (down, if it is negative):
+//	so do those of every part of the tree that covers it.
+//----------------------------------------------------------------------
+
+void
+LotteryTree::Add(int slot, int delta)
+{
+    tickets[slot] += delta;
+    total += delta;
+    for (int i = slot + 1; i <= room; i += i & -i)
+	tree[i] += delta;
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Grow
+// 	Double the number of slots, and build the tree over them again.
+//----------------------------------------------------------------------
+
+void
+LotteryTree::Grow()
+{
+    Thread **oldOwner = owner;
+    int *oldTickets = tickets;
+
+    room *= 2;
+    owner = new Thread*[room];
+    tickets = new int[room];
+    delete [] tree;
+    tree = new int[room + 1];
+    delete [] freeSlots;
+    freeSlots = new int[room];
+    for (int i = 0; i <= room; i++)
+	tree[i] = 0;
+    total = 0;
+    for (int i = 0; i < used; i++) {
+	owner[i] = oldOwner[i];
+	tickets[i] = 0;
+	Add(i, oldTickets[i]);
+    }
+    delete [] oldOwner;
+    delete [] oldTickets;
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Insert
+// 	Add "thread", which must not be in a lottery already, with
+//	"tickets" tickets.  A slot left by another thread is used first.
+//----------------------------------------------------------------------
+
+void
+LotteryTree::Insert(Thread *thread, int count)
+{
+    int slot;
+
+    ASSERT((thread->lotterySlot < 0) && (count > 0));
+    if (numFree > 0) {
+	slot = freeSlots[--numFree];
+    } else {
+	if (used == room)		// numFree == 0, so size == room
+	    Grow();
+	slot = used++;
+	tickets[slot] = 0;
+    }
+    owner[slot] = thread;
+    thread->lotterySlot = slot;
+    Add(slot, count);
+    size++;
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Remove
+// 	Take "thread", which must be in this set, off; its slot is free.
+//----------------------------------------------------------------------
+
+void
+LotteryTree::Remove(Thread *thread)
+{
+    int slot = thread->lotterySlot;
+
+    ASSERT(Contains(thread));
+    Add(slot, -tickets[slot]);
+    owner[slot] = NULL;
+    freeSlots[numFree++] = slot;
+    thread->lotterySlot = -1;
+    size--;
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::SetTickets
+// 	"thread", which must be in this set, holds "count" tickets now.
+//----------------------------------------------------------------------
+
+void
+LotteryTree::SetTickets(Thread *thread, int count)
+{
+    int slot = thread->lotterySlot;
+
+    ASSERT(Contains(thread) && (count > 0));
+    Add(slot, count - tickets[slot]);
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Contains
+// 	Return TRUE if "thread" is in this set, and not in another one.
+//----------------------------------------------------------------------
+
+bool
+LotteryTree::Contains(Thread *thread)
+{
+    int slot = thread->lotterySlot;
+
+    return (slot >= 0) && (slot < used) && (owner[slot] == thread);
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Holder
+// 	Return the thread that holds ticket number "ticket", from 0 to
+//	Total() - 1.  Go down the tree from the root, skipping each part
+//	whose tickets all come before "ticket"; where the walk ends is the
+//	slot "ticket" falls in.  Empty slots hold no tickets, so they are
+//	always skipped.
+//----------------------------------------------------------------------
+
+Thread *
+LotteryTree::Holder(int ticket)
+{
+    int slot = 0;
+
+    ASSERT((ticket >= 0) && (ticket < total));
+    for (int step = room; step > 0; step >>= 1) {
+	if ((slot + step <= room) && (tree[slot + step] <= ticket)) {
+	    slot += step;
+	    ticket -= tree[slot];
+	}
+    }
+    ASSERT(owner[slot] != NULL);
+    return owner[slot];
+}
+
+//----------------------------------------------------------------------
+// LotteryTree::Mapcar
+// 	Apply "func" to every thread in the set, in the order of their
+//	slots.
+//----------------------------------------------------------------------
+
+void
+LotteryTree::Mapcar(VoidFunctionPtr func)
+{
+    for (int i = 0; i < used; i++)
+	if (owner[i] != NULL)
+	    (*func)((int)owner[i]);
+}
@@ -0,0 +1,67 @@
+// lottery.h
+//	Data structures for a ready queue from which the lottery scheduler
+//	draws the next thread to run.
+//
+//	Each ready thread holds a number of tickets, and the next thread
+//	to run is the holder of a ticket drawn at random, so each thread
+//	runs in proportion to its tickets.  A LotteryTree numbers the
+//	tickets of the threads one after the other, in the order of the
+//	slots they are in, and keeps a Fenwick tree (a binary indexed
+//	tree) of the ticket counts by slot.  Adding or taking off a thread,
+//	changing its tickets, and finding the holder of a given ticket
+//	each take O(log n), instead of a walk over the whole list.
+//
+//	Each thread knows its slot, so that its tickets can be changed
+//	while it waits (when a thread lends it its own, see
+//	Scheduler::LendTickets).  The slots of the threads that leave are
+//	used again.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef LOTTERY_H
+#define LOTTERY_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define InitialLotterySize	16	// slots; grows by doubling
+
+// The following class defines a set of threads holding lottery tickets.
+
+class LotteryTree {
+  public:
+    LotteryTree();			// Initialize an empty set
+    ~LotteryTree();
+
+    void Insert(Thread *thread, int tickets);
+					// Add a thread with "tickets" > 0
+    void Remove(Thread *thread);	// Take this thread off
+    void SetTickets(Thread *thread, int tickets);
+					// It holds this many now
+    bool Contains(Thread *thread);	// Is it in this set?
+    Thread *Holder(int ticket);		// Who holds ticket number "ticket",
+					// 0 to Total() - 1?
+    int Total() { return total; }	// Tickets held, in all
+    int Size() { return size; }		// Threads in the set
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every thread,
+					// in the order of their slots
+
+  private:
+    Thread **owner;			// the thread in each slot, or NULL
+    int *tickets;			// the tickets of each slot
+    int *tree;				// tree[i]: the tickets of slots
+					// i - (i & -i) to i - 1; 1 to room
+    int *freeSlots;			// slots left by threads, to reuse
+    int numFree;
+    int used;				// slots ever used: 0 to used - 1
+    int room;				// slots allocated, a power of 2
+    int size;
+    int total;
+
+    void Add(int slot, int delta);	// the tickets of "slot" change
+    void Grow();			// double "room"
+};
+
+#endif // LOTTERY_H
@@ -9,19 +9,68 @@
 // 	Most of this file is not needed until later assignments.
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+//		-tr <trace classes> -tf <trace file> -prof -ticks -fair
+//		-s -bt -tlb <# entries> -ncpu <# cpus> -slice <ticks>
+//		-hw <# host threads> -A <algorithm> -ml <# levels>
+//		-mq <quantum>,<quantum>,... -mb <ticks>
+//		-q <ticks> -aq -pq -bp <predictor>
+//		-x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
-//              -z
+//              -z -bench
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -tr records trace events of the given classes (cf. trace.h), to
+//	  be written when Nachos halts and read with bin/tracedump
+//    -tf sets the trace file (default nachos.trace)
+//    -prof prints where the host time went, by part of Nachos (cf.
+//	  profile.h), when Nachos halts
+//    -ticks takes every timer interrupt while no thread can run, or
+//	  while a thread runs under FIFO or SJF, instead of skipping to
+//	  the next one with work to do (the simulated results are the
+//	  same, only slower to get)
+//    -fair prints the CPU time and ready-queue wait of each thread,
+//	  and how fairly the CPU was shared for their weights, when
+//	  Nachos halts; under stride and lottery scheduling, also each
+//	  thread's share of the CPU time against its tickets' share
 //    -z prints the copyright message
+//    -bench checks that the ready queue heap picks the threads the list
+//	  did, then times a dispatch from ready queues of growing length,
+//	  and an interrupt with more and more of them pending
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -bt runs user programs with the block translator instead of the
+//	  instruction-at-a-time interpreter (same results, same timing)
+//    -tlb sets the number of TLB entries (only when built with USE_TLB)
+//    -ncpu simulates a multiprocessor with the given number of CPUs
+//	  (at most MaxCPUs, see cpu.h); the block translator is not used
+//    -slice sets how many ticks each CPU runs per round (default
+//	  CPUSliceTicks); longer rounds delay interrupts but let -hw help
+//    -hw runs the CPUs' user code on this many host threads at once;
+//	  the simulation is the same for any number.  Ignored when built
+//	  with USE_TLB, and with -R 3 (LRU), which bypass the soft TLB
+//    -A sets the scheduling algorithm (cf. system.h); 5 is MLFQ, 6 is
+//	  CFS, 7 stride and 8 lottery scheduling (cf. scheduler.h).
+//	  Given before -F, it overrides the algorithm on the first line
+//	  of the batch file, e.g. -A 6 -F ../test/batch_scripts/inputmix_1.txt
+//    -ml sets the number of MLFQ levels (default MLFQLevels, with a
+//	  quantum of SCHED_QUANTUM doubling down the levels)
+//    -mq sets the quantum of each MLFQ level, highest first; as many
+//	  levels as quanta
+//    -mb sets the ticks between two MLFQ boosts (0: never)
+//    -bp chooses the burst predictor of the SJF scheduler: ewma-0.25,
+//	  ewma-0.5 (the default), ewma-0.75, median or history (cf.
+//	  predictor.h); all of them are scored
+//    -q sets the quantum of the round robin, UNIX, stride and lottery
+//	  schedulers (default SCHED_QUANTUM)
+//    -aq adapts that quantum to the CPU bursts: most of them fit in it
+//	  (cf. scheduler.h)
+//    -pq ends each quantum on the tick it is due, with an interrupt of
+//	  its own, rather than at the next timer interrupt (one CPU only)
 //    -x runs a user program
 //    -c tests the console
 //
@@ -57,11 +106,13 @@
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
+extern void ReadyQueueCheck(void), ReadyQueueBenchmark(void);
+extern void PendingQueueBenchmark(void);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
 
-extern void ReadInputAndFork(char *file);
+extern void ReadInputAndFork(char *file, int algo);
 
 //----------------------------------------------------------------------
 // main
@@ -84,6 +135,16 @@ main(int argc, char **argv)
 					// for a particular command
 
     int schedPriority = MAX_NICE_PRIORITY;
+#ifdef USER_PROGRAM
+    int mlfqLevels = MLFQLevels;		// the MLFQ configuration
+    int mlfqQuanta[MaxMLFQLevels];
+    bool mlfqQuantaGiven = FALSE;
+    int mlfqBoost = MLFQBoostPeriod;
+    char *quantum;
+    int fixedQuantum = SCHED_QUANTUM;	// the quantum of the others
+    bool adaptiveQuantum = FALSE, preciseQuantum = FALSE;
+    int batchAlgo = 0;			// -A, for -F; 0: the file's own
+#endif
 
     DEBUG('t', "Entering main");
     (void) Initialize(argc, argv);
@@ -96,12 +157,18 @@ main(int argc, char **argv)
 	argCount = 1;
         if (!strcmp(*argv, "-z"))               // print copyright
             printf (copyright);
+        if (!strcmp(*argv, "-bench")) {	// time the ready queues and
+            ReadyQueueCheck();		// the pending interrupts
+            ReadyQueueBenchmark();
+            PendingQueueBenchmark();
+        }
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-A")) {		// read scheduling algorithm
            schedulingAlgo = atoi(*(argv + 1));
+           batchAlgo = schedulingAlgo;
            argCount = 2;
-           ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= 4));
-           if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
+           ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= LOTTERY_SCHED));
+           if (scheduler->Preemptive()) {
               ASSERT (SCHED_QUANTUM > 0);
            }
            if (schedulingAlgo == UNIX_SCHED) {
@@ -109,6 +176,49 @@ main(int argc, char **argv)
               currentThread->SetPriority(schedPriority+DEFAULT_BASE_PRIORITY);
               currentThread->SetUsage(0);
            }
+        } else if (!strcmp(*argv, "-ml")) {	// number of MLFQ levels
+           ASSERT(argc > 1);
+           mlfqLevels = atoi(*(argv + 1));
+           mlfqQuantaGiven = FALSE;
+           argCount = 2;
+           scheduler->SetMLFQ(mlfqLevels, NULL, mlfqBoost);
+        } else if (!strcmp(*argv, "-mq")) {	// MLFQ quanta
+           ASSERT(argc > 1);
+           mlfqLevels = 0;
+           for (quantum = *(argv + 1); quantum != NULL; ) {
+              ASSERT(mlfqLevels < MaxMLFQLevels);
+              mlfqQuanta[mlfqLevels++] = atoi(quantum);
+              quantum = strchr(quantum, ',');
+              if (quantum != NULL)
+                 quantum++;
+           }
+           mlfqQuantaGiven = TRUE;
+           argCount = 2;
+           scheduler->SetMLFQ(mlfqLevels, mlfqQuanta, mlfqBoost);
+        } else if (!strcmp(*argv, "-mb")) {	// MLFQ boost period
+           ASSERT(argc > 1);
+           mlfqBoost = atoi(*(argv + 1));
+           argCount = 2;
+           scheduler->SetMLFQ(mlfqLevels, mlfqQuantaGiven ? mlfqQuanta : NULL,
+			      mlfqBoost);
+        } else if (!strcmp(*argv, "-bp")) {	// SJF burst predictor
+           ASSERT(argc > 1);
+           if (!scheduler->SetPredictor(*(argv + 1))) {
+              printf("Unknown burst predictor %s\n", *(argv + 1));
+              ASSERT(FALSE);
+           }
+           argCount = 2;
+        } else if (!strcmp(*argv, "-q")) {	// quantum
+           ASSERT(argc > 1);
+           fixedQuantum = atoi(*(argv + 1));
+           argCount = 2;
+           scheduler->SetQuantum(fixedQuantum, adaptiveQuantum, preciseQuantum);
+        } else if (!strcmp(*argv, "-aq")) {	// adaptive quantum
+           adaptiveQuantum = TRUE;
+           scheduler->SetQuantum(fixedQuantum, adaptiveQuantum, preciseQuantum);
+        } else if (!strcmp(*argv, "-pq")) {	// quantum interrupts
+           preciseQuantum = TRUE;
+           scheduler->SetQuantum(fixedQuantum, adaptiveQuantum, preciseQuantum);
         } else if (!strcmp(*argv, "-R")) { //page algo	
            pageAlgo = atoi(*(argv + 1));
             DEBUG('R', "The page replacement algorithm is %d\n", pageAlgo);
@@ -143,7 +253,7 @@ main(int argc, char **argv)
 					// for console input
 	} else if (!strcmp(*argv, "-F")) {	// test multiprogramming
             ASSERT (argc > 1);
-            ReadInputAndFork(*(argv + 1));
+            ReadInputAndFork(*(argv + 1), batchAlgo);
             argCount = 2;
         }
 #endif // USER_PROGRAM
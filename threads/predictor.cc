@@ -0,0 +1,290 @@
+// predictor.cc
+//	Routines to predict CPU bursts.  See predictor.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "predictor.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// BurstPredictor::BurstPredictor
+// 	Initialize a predictor called "predictorName", that has scored
+//	no burst yet.
+//----------------------------------------------------------------------
+
+BurstPredictor::BurstPredictor(char *predictorName)
+{
+    name = predictorName;
+    error = 0;
+    count = 0;
+}
+
+//----------------------------------------------------------------------
+// BurstPredictor::Score
+// 	"thread" has just had a CPU burst of "burst" ticks: add how far
+//	off the prediction was.  Called before the burst is observed.
+//----------------------------------------------------------------------
+
+void
+BurstPredictor::Score(Thread *thread, int burst)
+{
+    error += abs(burst - Predict(thread));
+    count++;
+}
+
+//----------------------------------------------------------------------
+// BurstPredictor::Slot
+// 	Return where the state of "thread" is kept: its pid, or
+//	MAX_THREAD_COUNT for all the threads with none.
+//----------------------------------------------------------------------
+
+int
+BurstPredictor::Slot(Thread *thread)
+{
+    int pid = thread->GetPID();
+
+    return ((pid >= 0) && (pid < MAX_THREAD_COUNT)) ? pid : MAX_THREAD_COUNT;
+}
+
+//----------------------------------------------------------------------
+// EWMAPredictor::EWMAPredictor, EWMAPredictor::~EWMAPredictor
+// 	Initialize an exponential average with weight "weight" on the
+//	newest burst; de-allocate it.
+//----------------------------------------------------------------------
+
+EWMAPredictor::EWMAPredictor(char *predictorName, double weight)
+	: BurstPredictor(predictorName)
+{
+    ASSERT((weight > 0) && (weight <= 1));
+    alpha = weight;
+    estimate = new int[MAX_THREAD_COUNT + 1];
+    for (int i = 0; i <= MAX_THREAD_COUNT; i++)
+	estimate[i] = INITIAL_TAU;
+}
+
+EWMAPredictor::~EWMAPredictor()
+{
+    delete [] estimate;
+}
+
+//----------------------------------------------------------------------
+// EWMAPredictor::Predict, EWMAPredictor::Observe
+// 	Return the average for "thread"; move it towards "burst".
+//----------------------------------------------------------------------
+
+int
+EWMAPredictor::Predict(Thread *thread)
+{
+    return estimate[Slot(thread)];
+}
+
+void
+EWMAPredictor::Observe(Thread *thread, int burst)
+{
+    int slot = Slot(thread);
+
+    estimate[slot] = (int)(alpha*burst + (1-alpha)*estimate[slot]);
+}
+
+//----------------------------------------------------------------------
+// MedianPredictor::MedianPredictor, MedianPredictor::~MedianPredictor
+// 	Initialize a median of the last PredictorWindow bursts of each
+//	thread; de-allocate it.
+//----------------------------------------------------------------------
+
+MedianPredictor::MedianPredictor(char *predictorName)
+	: BurstPredictor(predictorName)
+{
+    bursts = new int[MAX_THREAD_COUNT + 1][PredictorWindow];
+    seen = new int[MAX_THREAD_COUNT + 1];
+    for (int i = 0; i <= MAX_THREAD_COUNT; i++)
+	seen[i] = 0;
+}
+
+MedianPredictor::~MedianPredictor()
+{
+    delete [] bursts;
+    delete [] seen;
+}
+
+//----------------------------------------------------------------------
+// MedianPredictor::Predict
+// 	Return the median of the last bursts of "thread", up to
+//	PredictorWindow of them, or INITIAL_TAU if it has had none.
+//	With an even number of them, the lower of the middle two.
+//----------------------------------------------------------------------
+
+int
+MedianPredictor::Predict(Thread *thread)
+{
+    int slot = Slot(thread);
+    int n = min(seen[slot], PredictorWindow);
+    int sorted[PredictorWindow];
+    int i, j, burst;
+
+    if (n == 0)
+	return INITIAL_TAU;
+    for (i = 0; i < n; i++) {		// insertion sort; n is small
+	burst = bursts[slot][i];
+	for (j = i; (j > 0) && (sorted[j - 1] > burst); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = burst;
+    }
+    return sorted[(n - 1) / 2];
+}
+
+//----------------------------------------------------------------------
+// MedianPredictor::Observe
+// 	Put "burst" in the ring of "thread", in place of its oldest.
+//----------------------------------------------------------------------
+
+void
+MedianPredictor::Observe(Thread *thread, int burst)
+{
+    int slot = Slot(thread);
+
+    bursts[slot][seen[slot] % PredictorWindow] = burst;
+    seen[slot]++;
+}
+
+//----------------------------------------------------------------------
+// HistoryPredictor::HistoryPredictor
+// 	Initialize an exponential average of the bursts of each
+//	executable, with weight "weight" on the newest, kept in "file"
+//	from one run to the next if it is chosen (see Load).
+//----------------------------------------------------------------------
+
+HistoryPredictor::HistoryPredictor(char *predictorName, double weight,
+				   char *file)
+	: BurstPredictor(predictorName)
+{
+    ASSERT((weight > 0) && (weight <= 1));
+    alpha = weight;
+    fileName = file;
+    numPrograms = 0;
+    changed = loaded = FALSE;
+}
+
+HistoryPredictor::~HistoryPredictor()
+{
+    for (int i = 0; i < numPrograms; i++)
+	delete [] program[i];
+}
+
+//----------------------------------------------------------------------
+// HistoryPredictor::Load
+// 	Read the averages of the earlier runs from the file, if there is
+//	one, in place of those of this run so far.  Each line of it is
+//	an average and the name of the executable.  From now on, Save
+//	writes them back.
+//----------------------------------------------------------------------
+
+void
+HistoryPredictor::Load()
+{
+    char line[400], programName[310];
+    int average;
+    FILE *history;
+
+    if (loaded)
+	return;
+    loaded = TRUE;
+    for (int i = 0; i < numPrograms; i++)
+	delete [] program[i];
+    numPrograms = 0;
+
+    history = fopen(fileName, "r");
+    if (history == NULL)
+	return;
+    while ((numPrograms < MaxPrograms)
+		&& (fgets(line, sizeof(line), history) != NULL)) {
+	if (sscanf(line, "%d %300s", &average, programName) != 2)
+	    continue;
+	program[numPrograms] = new char[strlen(programName) + 1];
+	strcpy(program[numPrograms], programName);
+	estimate[numPrograms] = average;
+	numPrograms++;
+    }
+    fclose(history);
+}
+
+//----------------------------------------------------------------------
+// HistoryPredictor::Find
+// 	Return the entry of the executable "thread" runs, adding one if
+//	"add" and there is room.  Return -1 if there is none, or if the
+//	thread runs no user program.
+//----------------------------------------------------------------------
+
+int
+HistoryPredictor::Find(Thread *thread, bool add)
+{
+    char *executable = NULL;
+
+#ifdef USER_PROGRAM
+    if (thread->space != NULL)
+	executable = thread->space->filename;
+#endif
+    if ((executable == NULL) || (executable[0] == '\0'))
+	return -1;
+    for (int i = 0; i < numPrograms; i++)
+	if (!strcmp(program[i], executable))
+	    return i;
+    if (!add || (numPrograms == MaxPrograms))
+	return -1;
+    program[numPrograms] = new char[strlen(executable) + 1];
+    strcpy(program[numPrograms], executable);
+    estimate[numPrograms] = INITIAL_TAU;
+    return numPrograms++;
+}
+
+//----------------------------------------------------------------------
+// HistoryPredictor::Predict, HistoryPredictor::Observe
+// 	Return the average of the executable of "thread", INITIAL_TAU if
+//	it has none yet; move it towards "burst".
+//----------------------------------------------------------------------
+
+int
+HistoryPredictor::Predict(Thread *thread)
+{
+    int i = Find(thread, FALSE);
+
+    return (i >= 0) ? estimate[i] : INITIAL_TAU;
+}
+
+void
+HistoryPredictor::Observe(Thread *thread, int burst)
+{
+    int i = Find(thread, TRUE);
+
+    if (i < 0)
+	return;
+    estimate[i] = (int)(alpha*burst + (1-alpha)*estimate[i]);
+    changed = TRUE;
+}
+
+//----------------------------------------------------------------------
+// HistoryPredictor::Save
+// 	Write the averages to the file, for the next run, if they were
+//	read from it (see Load) and have changed.
+//----------------------------------------------------------------------
+
+void
+HistoryPredictor::Save()
+{
+    FILE *history;
+
+    if (!loaded || !changed)
+	return;
+    history = fopen(fileName, "w");
+    if (history == NULL) {
+	printf("Cannot write burst history file %s\n", fileName);
+	return;
+    }
+    for (int i = 0; i < numPrograms; i++)
+	fprintf(history, "%d %s\n", estimate[i], program[i]);
+    fclose(history);
+    changed = FALSE;
+}
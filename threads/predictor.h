@@ -0,0 +1,128 @@
+// predictor.h
+//	Data structures for predicting the next CPU burst of a thread,
+//	which the shortest-job-first scheduler orders the ready threads by.
+//
+//	A BurstPredictor is told the length of every burst a thread has,
+//	and asked how long its next one will be.  Several predictors run
+//	side by side: the one chosen with "-bp" sets the order of the
+//	ready threads, and all of them are scored, by the mean absolute
+//	difference between what they predicted and the burst that came,
+//	so that they can be compared on the same run.
+//
+//	EWMAPredictor	an exponential average of the thread's bursts,
+//			with weight "alpha" on the newest
+//	MedianPredictor	the median of its last PredictorWindow bursts,
+//			which one odd burst does not throw off
+//	HistoryPredictor an exponential average of the bursts of every
+//			thread that ran the same executable, kept in a
+//			file from one run of Nachos to the next, so that
+//			even a thread's first burst is predicted.  The
+//			file is only read and written when this is the
+//			predictor chosen with "-bp history"; otherwise
+//			it starts from nothing, like the others
+//
+//	Every prediction starts out at INITIAL_TAU.  The threads that run
+//	no user program, and so have no pid, share one prediction.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define MaxPredictors	8	// predictors run side by side, at most
+#define PredictorWindow	5	// bursts MedianPredictor looks at
+#define MaxPrograms	64	// executables HistoryPredictor tracks
+#define BurstHistoryFile "nachos.bursts"	// where it keeps them
+
+// The following class defines the interface of a burst predictor.
+
+class BurstPredictor {
+  public:
+    BurstPredictor(char *predictorName);
+    virtual ~BurstPredictor() {}
+
+    virtual int Predict(Thread *thread) = 0;
+					// How long will its next burst be?
+    virtual void Observe(Thread *thread, int burst) = 0;
+					// It has just had this one
+    virtual void Load() {}		// It has been chosen with -bp
+    virtual void Save() {}		// ... and Nachos is halting
+
+    void Score(Thread *thread, int burst);
+					// Compare the prediction with the
+					// burst, before observing it
+    char *Name() { return name; }
+    double MeanError() { return (count > 0) ? (double)error / count : 0; }
+    int Count() { return count; }
+
+  protected:
+    int Slot(Thread *thread);		// where its state is kept
+
+  private:
+    char *name;
+    long long error;			// sum of the absolute errors
+    int count;				// bursts scored
+};
+
+// An exponential average of each thread's bursts.
+
+class EWMAPredictor : public BurstPredictor {
+  public:
+    EWMAPredictor(char *predictorName, double weight);
+    ~EWMAPredictor();
+
+    int Predict(Thread *thread);
+    void Observe(Thread *thread, int burst);
+
+  private:
+    double alpha;			// weight of the newest burst
+    int *estimate;			// by pid; the last is for the
+					// threads with none
+};
+
+// The median of each thread's last few bursts.
+
+class MedianPredictor : public BurstPredictor {
+  public:
+    MedianPredictor(char *predictorName);
+    ~MedianPredictor();
+
+    int Predict(Thread *thread);
+    void Observe(Thread *thread, int burst);
+
+  private:
+    int (*bursts)[PredictorWindow];	// a ring of the last ones, by pid
+    int *seen;				// how many bursts, ever
+};
+
+// An exponential average of the bursts of each executable, across runs.
+
+class HistoryPredictor : public BurstPredictor {
+  public:
+    HistoryPredictor(char *predictorName, double weight, char *file);
+    ~HistoryPredictor();
+
+    int Predict(Thread *thread);
+    void Observe(Thread *thread, int burst);
+    void Load();			// Read the table from the file
+    void Save();			// Write it back
+
+  private:
+    double alpha;			// weight of the newest burst
+    char *fileName;
+    char *program[MaxPrograms];		// the executables seen
+    int estimate[MaxPrograms];		// ... and their averages
+    int numPrograms;
+    bool loaded;			// was it read from the file?
+    bool changed;			// is the file out of date?
+
+    int Find(Thread *thread, bool add);	// the entry of its executable,
+					// -1 if none (or no room)
+};
+
+#endif // PREDICTOR_H
@@ -0,0 +1,168 @@
+// profile.cc
+//	Routines for profiling the simulator.  See profile.h.
+//
+//	Only the host thread that runs the kernel profiles anything; the
+//	host workers of RunParallel do not time their instructions, so
+//	the counters need no locking.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+
+bool profiling = FALSE;
+
+static char *profileNames[NumProfiled] = {
+    "user code", "Translate", "page replacement", "ExceptionHandler",
+    "Scheduler::Run", "FindNextToRun", "CheckIfDue", "disk I/O"
+};
+
+static long long profileCycles[NumProfiled];	// charged to each
+static int profileCalls[NumProfiled];
+static ProfileScope *openScopes = NULL;		// the innermost first
+
+static long long startNs, startCycles;	// to convert cycles to time
+
+//----------------------------------------------------------------------
+// ProfileInit
+// 	Reset the counters, and start profiling if "on".
+//----------------------------------------------------------------------
+
+void
+ProfileInit(bool on)
+{
+    for (int i = 0; i < NumProfiled; i++) {
+	profileCycles[i] = 0;
+	profileCalls[i] = 0;
+    }
+#ifndef USE_PROFILE
+    if (on)
+	printf("Profiling was compiled out; rebuild with -DUSE_PROFILE for -prof.\n");
+#endif
+    profiling = on;
+    startNs = HostNanoseconds();
+    startCycles = HostCycles();
+}
+
+//----------------------------------------------------------------------
+// ProfileScope::ProfileScope, ProfileScope::End
+// 	Start timing a run of component "which" (-1: do not time it),
+//	and charge it the cycles since.
+//----------------------------------------------------------------------
+
+ProfileScope::ProfileScope(int which)
+{
+    if (!profiling || (which < 0)) {
+	component = -1;
+	return;
+    }
+    component = which;
+    outer = openScopes;
+    openScopes = this;
+    start = HostCycles();
+}
+
+void
+ProfileScope::End()
+{
+    if (component < 0)
+	return;
+    profileCycles[component] += HostCycles() - start;
+    profileCalls[component]++;
+    component = -1;
+
+    // Blocks end in the reverse order they start, except that End
+    // may be called early; take this one off the stack wherever it is
+    if (openScopes == this) {
+	openScopes = outer;
+    } else {
+	for (ProfileScope *scope = openScopes; scope != NULL;
+					scope = scope->outer)
+	    if (scope->outer == this) {
+		scope->outer = outer;
+		break;
+	    }
+    }
+}
+
+//----------------------------------------------------------------------
+// ProfileScope::Lap
+// 	Charge the component the cycles since the start, or since the
+//	last lap, as one run, and start timing the next one.
+//----------------------------------------------------------------------
+
+void
+ProfileScope::Lap()
+{
+    long long now;
+
+    if (component < 0)
+	return;
+    now = HostCycles();
+    profileCycles[component] += now - start;
+    profileCalls[component]++;
+    start = now;
+}
+
+//----------------------------------------------------------------------
+// ProfileSwitch::ProfileSwitch, ProfileSwitch::Resume
+// 	Set aside the open blocks of a thread that is being switched
+//	out, and when it comes back, move their start times forward by
+//	the time it was away, so they are not charged for it.  A thread
+//	that starts fresh has no open blocks.
+//----------------------------------------------------------------------
+
+ProfileSwitch::ProfileSwitch()
+{
+    open = openScopes;
+    openScopes = NULL;
+    start = profiling ? HostCycles() : 0;
+}
+
+void
+ProfileSwitch::Resume()
+{
+    long long away;
+
+    openScopes = open;
+    if (!profiling)
+	return;
+    away = HostCycles() - start;
+    for (ProfileScope *scope = open; scope != NULL; scope = scope->outer)
+	scope->start += away;
+}
+
+//----------------------------------------------------------------------
+// ProfilePrint
+// 	Print the host time charged to each component, in total and per
+//	run, and as a share of the host time since profiling started.
+//----------------------------------------------------------------------
+
+void
+ProfilePrint()
+{
+    long long elapsedNs, elapsedCycles;
+    double nsPerCycle;
+
+    if (!profiling)
+	return;
+    elapsedNs = HostNanoseconds() - startNs;
+    elapsedCycles = HostCycles() - startCycles;
+    nsPerCycle = (elapsedCycles > 0) ? (double) elapsedNs / elapsedCycles : 0;
+
+    printf("\nHost time profile (inclusive), %.1f ms in all:\n",
+	   elapsedNs / 1e6);
+    printf("%-18s %12s %12s %10s %7s\n", "component", "calls", "ms",
+	   "ns/call", "share");
+    for (int i = 0; i < NumProfiled; i++) {
+	double ns = profileCycles[i] * nsPerCycle;
+
+	if (profileCalls[i] == 0)
+	    continue;
+	printf("%-18s %12d %12.2f %10.1f %6.1f%%\n", profileNames[i],
+	       profileCalls[i], ns / 1e6, ns / profileCalls[i],
+	       (elapsedNs > 0) ? 100.0 * ns / elapsedNs : 0.0);
+    }
+}
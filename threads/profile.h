@@ -0,0 +1,104 @@
+// profile.h
+//	A profiler of the simulator itself: how much host time goes into
+//	each part of Nachos, as opposed to the simulated ticks that
+//	stats.h counts.
+//
+//	A part is profiled by putting PROFILE(component) at the top of
+//	the block that does it; the host cycles until the end of the
+//	block, and the number of times it runs, are added to the
+//	component's counters.  With "-prof", the table is printed when
+//	Nachos halts.  Unless Nachos is compiled with -DUSE_PROFILE, the
+//	macros turn into nothing; with it, a block costs one test of a
+//	flag unless profiling is on.
+//
+//	Each PROFILE gets a name of its own, so that the blocks can nest
+//	within one routine.  A block that must be ended before the end of
+//	its scope is named: PROFILE_NAMED(name, component), and then
+//	PROFILE_END(name).
+//
+//	The times are inclusive: a Translate done while running user code
+//	is counted in both.  A block that never ends, like the loop that
+//	runs user code, is charged in laps: PROFILE_LAP(name) charges the
+//	time since the last lap as one run.  While a thread is switched
+//	out, the blocks it is in are not charged for what the other
+//	threads do.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The profiled parts of Nachos
+#define ProfUserCode		0	// Machine::Run, RunBlocks; per lap
+#define ProfTranslate		1	// Machine::Translate
+#define ProfReplacement		2	// page replacement policies
+#define ProfException		3	// ExceptionHandler
+#define ProfSchedRun		4	// Scheduler::Run, up to the switch
+#define ProfFindNext		5	// Scheduler::FindNextToRun
+#define ProfCheckIfDue		6	// Interrupt::CheckIfDue
+#define ProfDiskIO		7	// disk requests, executable reads
+#define NumProfiled		8
+
+extern bool profiling;			// is the profiler on?
+
+extern void ProfileInit(bool on);	// Start profiling if "on"
+extern void ProfilePrint();		// Print the table
+
+// The following class times one run of a profiled block.  The open
+// ones form a stack, innermost first, so that a context switch can
+// stop their clocks (see ProfileSwitch).
+
+class ProfileScope {
+  public:
+    ProfileScope(int which);		// Start timing, if profiling
+    ~ProfileScope() { End(); }		// Charge the component
+    void End();				// ... sooner, at most once
+    void Lap();				// Charge it so far, and go on
+
+    long long start;			// host cycles at the start
+    ProfileScope *outer;		// the enclosing open block
+
+  private:
+    int component;			// -1 once charged, or if not timed
+};
+
+// The following class stops the clocks of the current thread's open
+// blocks while it is switched out.  Declared just before the switch,
+// and resumed just after it, in the thread that is switched back in.
+
+class ProfileSwitch {
+  public:
+    ProfileSwitch();			// The current thread is leaving
+    void Resume();			// It is back
+
+  private:
+    ProfileScope *open;			// its open blocks
+    long long start;			// when it left
+};
+
+#define PROFILE_CONCAT2(a, b)	a##b
+#define PROFILE_CONCAT(a, b)	PROFILE_CONCAT2(a, b)
+
+#ifdef USE_PROFILE
+#define PROFILE(which)		ProfileScope \
+				    PROFILE_CONCAT(profileScope, __LINE__)(which)
+#define PROFILE_NAMED(name, which) ProfileScope name(which)
+#define PROFILE_END(name)	name.End()
+#define PROFILE_LAP(name)	name.Lap()
+#define PROFILE_SWITCH()	ProfileSwitch profileSwitch
+#define PROFILE_RESUME()	profileSwitch.Resume()
+#else
+#define PROFILE(which)
+#define PROFILE_NAMED(name, which)
+#define PROFILE_END(name)
+#define PROFILE_LAP(name)
+#define PROFILE_SWITCH()
+#define PROFILE_RESUME()
+#endif // USE_PROFILE
+
+#endif // PROFILE_H
@@ -14,6 +14,10 @@
 // 	Very simple implementation -- no priorities, straight FIFO.
 //	Might need to be improved in later assignments.
 //
+//	With several simulated CPUs, each CPU has a ready list of its
+//	own (see scheduler.h); the statistics of how often threads move
+//	between them are kept in stats.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -21,15 +25,52 @@
 #include "copyright.h"
 #include "scheduler.h"
 #include "system.h"
+#include "trace.h"
+#include "profile.h"
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads to empty.
+//	There is a single list until SetNumQueues is called.
 //----------------------------------------------------------------------
 
 Scheduler::Scheduler()
 { 
-    readyList = new List;
+    numQueues = 1;
+    readyList = new List*[1];
+    readyList[0] = new List;
+    readyHeap = new ThreadHeap*[1];
+    readyHeap[0] = new ThreadHeap;
+    readyLottery = new LotteryTree*[1];
+    readyLottery[0] = new LotteryTree;
+    queueLength = new int[1];
+    queueLength[0] = 0;
+    numReady = 0;
+    decayEpoch = 0;
+    decayRoom = InitialHeapSize;
+    decaying = new Thread*[decayRoom];
+    numDecaying = 0;
+    mlfqLevels = MLFQLevels;
+    for (int i = 0; i < MaxMLFQLevels; i++)
+	mlfqQuantum[i] = SCHED_QUANTUM << i;	// doubling down the levels
+    boostPeriod = MLFQBoostPeriod;
+    lastBoost = 0;
+    minVruntime = 0;
+    readyWeight = 0;
+    reportFairness = FALSE;
+    numPredictors = 0;
+    predictors[numPredictors++] = new EWMAPredictor("ewma-0.25", 0.25);
+    predictors[numPredictors++] = predictor = new EWMAPredictor("ewma-0.5", ALPHA);
+    predictors[numPredictors++] = new EWMAPredictor("ewma-0.75", 0.75);
+    predictors[numPredictors++] = new MedianPredictor("median");
+    predictors[numPredictors++] = new HistoryPredictor("history", ALPHA,
+						       BurstHistoryFile);
+    baseQuantum = adaptiveQuantum = SCHED_QUANTUM;
+    adaptiveQuanta = preciseQuanta = FALSE;
+    numBursts = nextBurst = 0;
+    quantumBurst = 0;
+    armedBurst = -1;
+    quantumInterrupt = NULL;
     empty_ready_queue_start_time = -1;
 } 
 
@@ -40,9 +81,163 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    for (int i = 0; i < numQueues; i++) {
+	delete readyList[i];
+	delete readyHeap[i];
+	delete readyLottery[i];
+    }
+    delete [] readyList;
+    delete [] readyHeap;
+    delete [] readyLottery;
+    delete [] queueLength;
+    delete [] decaying;
+    for (int i = 0; i < numPredictors; i++)
+	delete predictors[i];
 } 
 
+//----------------------------------------------------------------------
+// Scheduler::SetNumQueues
+// 	Give each of "n" CPUs a ready list of its own.  Called once, when
+//	the CPUs are started; any thread already ready stays on the list
+//	of CPU 0.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetNumQueues(int n)
+{
+    List **lists = new List*[n];
+    ThreadHeap **heaps = new ThreadHeap*[n];
+    LotteryTree **lotteries = new LotteryTree*[n];
+    int *lengths = new int[n];
+
+    ASSERT((numQueues == 1) && (n >= 1));
+    lists[0] = readyList[0];
+    heaps[0] = readyHeap[0];
+    lotteries[0] = readyLottery[0];
+    lengths[0] = queueLength[0];
+    for (int i = 1; i < n; i++) {
+	lists[i] = new List;
+	heaps[i] = new ThreadHeap;
+	lotteries[i] = new LotteryTree;
+	lengths[i] = 0;
+    }
+    delete [] readyList;
+    delete [] readyHeap;
+    delete [] readyLottery;
+    delete [] queueLength;
+    readyList = lists;
+    readyHeap = heaps;
+    readyLottery = lotteries;
+    queueLength = lengths;
+    numQueues = n;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ByPriority
+// 	Return TRUE if the scheduling policy runs the ready thread with
+//	the best priority first, so that the heaps are used instead of
+//	the lists.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::ByPriority()
+{
+    return (schedulingAlgo == UNIX_SCHED) || (schedulingAlgo == NON_PREEMPTIVE_SJF)
+		|| (schedulingAlgo == MLFQ_SCHED) || (schedulingAlgo == CFS_SCHED)
+		|| (schedulingAlgo == STRIDE_SCHED);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Proportional
+// 	Return TRUE if the scheduling policy shares the CPU out by
+//	tickets.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::Proportional()
+{
+    return (schedulingAlgo == STRIDE_SCHED) || (schedulingAlgo == LOTTERY_SCHED);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Enqueue
+// 	Put "thread" at the end of ready list "which".  Under the lottery
+//	scheduler, it holds its tickets in the lottery of "which" instead.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Enqueue(int which, Thread *thread)
+{
+    if (schedulingAlgo == UNIX_SCHED) {
+       thread->DecayUsage(decayEpoch);
+       if (thread->GetUsage() > 0)
+          StartDecay(thread);
+    }
+    else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
+       thread->SetPriority(predictor->Predict(thread));
+    }
+    else if (schedulingAlgo == MLFQ_SCHED) {
+       thread->SetPriority(LevelOf(thread));
+    }
+    else if (schedulingAlgo == CFS_SCHED) {
+       thread->SetPriority(0);		// ordered by vruntime
+       readyWeight += Weight(thread->GetBasePriority() - DEFAULT_BASE_PRIORITY);
+    }
+    else if (schedulingAlgo == STRIDE_SCHED) {
+       thread->SetPriority(0);		// ordered by pass
+    }
+    if (schedulingAlgo == LOTTERY_SCHED)
+       readyLottery[which]->Insert(thread, TicketsOf(thread));
+    else if (ByPriority())
+       readyHeap[which]->Insert(thread);
+    else
+       readyList[which]->Append((void *)thread);
+    queueLength[which]++;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LocalQueue
+// 	Return the number of the ready list of the current CPU.
+//----------------------------------------------------------------------
+
+int
+Scheduler::LocalQueue()
+{
+#ifdef USER_PROGRAM
+    if (numQueues > 1)
+	return currentCPU->id;
+#endif
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ShortestQueue, Scheduler::LongestQueue
+// 	Return the number of the ready list holding the fewest (most)
+//	threads.  Ties go to "prefer" (the lowest number).
+//----------------------------------------------------------------------
+
+int
+Scheduler::ShortestQueue(int prefer)
+{
+    int best = prefer;
+
+    for (int i = 0; i < numQueues; i++)
+	if (queueLength[i] < queueLength[best])
+	    best = i;
+    return best;
+}
+
+int
+Scheduler::LongestQueue()
+{
+    int best = 0;
+
+    for (int i = 1; i < numQueues; i++)
+	if (queueLength[i] > queueLength[best])
+	    best = i;
+    return best;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
@@ -54,41 +249,651 @@ Scheduler::~Scheduler()
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
+    int which, last;
+
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
     if (thread->getStatus() == RUNNING) {
-       stats->cpu_time += (stats->totalTicks - cpu_burst_start_time);
-       if ((stats->totalTicks - cpu_burst_start_time) > 0) {
-          stats->cpu_burst_count++;
-          stats->preemptive_switch++;
-          if ((stats->totalTicks - cpu_burst_start_time) > stats->max_cpu_burst) {
-             stats->max_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
-             stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if (schedulingAlgo == UNIX_SCHED) {
-             UpdateThreadPriority();
-          }
-          else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
-             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - thread->GetPriority());
-             thread->SetPriority((int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*thread->GetPriority()));
-          }
-       }
+       EndBurst(thread, TRUE);
+    }
+    else if ((schedulingAlgo == CFS_SCHED) || (schedulingAlgo == STRIDE_SCHED)) {
+       PlaceWaking(thread);
     }
     thread->setStatus(READY);
     thread->SetWaitStartTime(stats->totalTicks);
-    if (readyList->IsEmpty() && (empty_ready_queue_start_time != -1)) {
+    if ((numReady == 0) && (empty_ready_queue_start_time != -1)) {
        stats->empty_ready_queue_time += (stats->totalTicks - empty_ready_queue_start_time);
        empty_ready_queue_start_time = -1;
     }
-    readyList->Append((void *)thread);
+
+    // Keep the thread on the CPU whose caches it warmed up last,
+    // unless that CPU is much busier than another one.  A new thread
+    // goes to the least busy CPU, this one if it is as good as any.
+    which = ShortestQueue(LocalQueue());
+    last = thread->GetLastCPU();
+    if ((last >= 0) && (last < numQueues)
+		&& (queueLength[last] <= queueLength[which] + AffinitySlack))
+       which = last;
+    Enqueue(which, thread);
+    numReady++;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::EndBurst
+// 	The current thread is leaving the CPU: charge it the CPU burst it
+//	has just had, in the statistics and by the scheduling policy.
+//	Its priority (UNIX), the bursts it is predicted by (SJF), its level
+//	(MLFQ) or its virtual runtime (CFS) or pass (stride) is updated
+//	before it goes back into a ready queue.
+//
+//	"thread" is the current thread.
+//	"preempted" is TRUE if it stays ready (it yields, or its quantum
+//	is up), FALSE if it blocks or exits.
+//----------------------------------------------------------------------
+
+void
+Scheduler::EndBurst (Thread *thread, bool preempted)
+{
+    int burst = stats->totalTicks - cpu_burst_start_time;
+    int nice = thread->GetBasePriority() - DEFAULT_BASE_PRIORITY;
+    int level, quantum;
+
+    quantumBurst++;			// its quantum interrupt is void
+    CancelQuantum();
+    stats->cpu_time += burst;
+    if (burst <= 0)
+       return;
+    if (thread->GetPID() >= 0) {
+       cpuTimeArray[thread->GetPID()] += burst;
+       niceArray[thread->GetPID()] = nice;
+       if (Proportional())
+          ticketTimeArray[thread->GetPID()] += (long long)burst * TicketsOf(thread);
+    }
+    stats->cpu_burst_count++;
+    if (preempted)
+       stats->preemptive_switch++;
+    else
+       stats->nonpreemptive_switch++;
+    if (burst > stats->max_cpu_burst) {
+       stats->max_cpu_burst = burst;
+    }
+    if (burst < stats->min_cpu_burst) {
+       stats->min_cpu_burst = burst;
+    }
+    if (adaptiveQuanta) {
+       quantum = Quantum(thread);
+       if (preempted && (burst >= quantum))
+          RecordBurst(quantum, TRUE);	// it wanted more
+       else
+          RecordBurst(burst, FALSE);
+    }
+
+    if (schedulingAlgo == UNIX_SCHED) {
+       UpdateThreadPriority();
+    }
+    else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
+       stats->burstEstimateError += abs(burst - predictor->Predict(thread));
+       for (int i = 0; i < numPredictors; i++) {
+          predictors[i]->Score(thread, burst);
+          predictors[i]->Observe(thread, burst);
+       }
+    }
+    else if (schedulingAlgo == MLFQ_SCHED) {
+       // Only a thread that used up its quantum drops a level
+       level = LevelOf(thread);
+       if (preempted && (burst >= mlfqQuantum[level]) && (level < mlfqLevels - 1)) {
+          thread->SetLevel(level + 1, BoostEpoch());
+          DEBUG('t', "Thread \"%s\" drops to MLFQ level %d\n",
+		thread->getName(), level + 1);
+       }
+    }
+    else if (schedulingAlgo == CFS_SCHED) {
+       thread->SetVruntime(thread->GetVruntime()
+			   + ((long long)burst << VruntimeShift)
+			     * CFSNiceZeroWeight / Weight(nice));
+       UpdateMinVruntime(thread, preempted);
+    }
+    else if (schedulingAlgo == STRIDE_SCHED) {
+       thread->SetVruntime(thread->GetVruntime()
+			   + (long long)burst * StrideOne / TicketsOf(thread));
+       UpdateMinVruntime(thread, preempted);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Preemptive, Scheduler::Quantum
+// 	Return TRUE if the scheduling policy takes the CPU away from a
+//	thread whose quantum is up; return the length of the quantum of
+//	"thread", which depends on its level under MLFQ, and under CFS
+//	on its weight against that of all the threads that want to run.
+//	The other policies give every thread the same quantum, which
+//	may adapt to the CPU bursts (see SetQuantum).
+//----------------------------------------------------------------------
+
+bool
+Scheduler::Preemptive ()
+{
+    return (schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)
+		|| (schedulingAlgo == MLFQ_SCHED) || (schedulingAlgo == CFS_SCHED)
+		|| Proportional();
+}
+
+int
+Scheduler::Quantum (Thread *thread)
+{
+    int weight, slice;
+
+    if (schedulingAlgo == MLFQ_SCHED)
+       return mlfqQuantum[LevelOf(thread)];
+    if (schedulingAlgo == CFS_SCHED) {
+       weight = Weight(thread->GetBasePriority() - DEFAULT_BASE_PRIORITY);
+       slice = (int)((long long)CFSLatency * weight / (readyWeight + weight));
+       return max(slice, CFSMinGranularity);
+    }
+    return adaptiveQuanta ? adaptiveQuantum : baseQuantum;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetPredictor
+// 	Make the SJF scheduler order the ready threads by the predictions
+//	of the predictor called "name" (see predictor.h), and let it load
+//	what it kept from the earlier runs.  Return FALSE if there is
+//	none.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::SetPredictor(char *name)
+{
+    for (int i = 0; i < numPredictors; i++) {
+       if (!strcmp(predictors[i]->Name(), name)) {
+          predictor = predictors[i];
+          predictor->Load();
+          return TRUE;
+       }
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintPredictors
+// 	Print how far off each burst predictor was, on average, over the
+//	bursts of the run, the one in use marked with a "*", and let that
+//	one save what it wants to keep for the next run.  Called when
+//	Nachos halts, under the SJF scheduler.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintPredictors()
+{
+    printf("Burst predictors, mean absolute error in ticks:\n");
+    for (int i = 0; i < numPredictors; i++) {
+       printf("  %-10s %c %10.2f  (%d bursts)\n", predictors[i]->Name(),
+	      (predictors[i] == predictor) ? '*' : ' ',
+	      predictors[i]->MeanError(), predictors[i]->Count());
+    }
+    predictor->Save();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetQuantum
+// 	Configure the quantum of the round robin, UNIX, stride and lottery
+//	schedulers.
+//
+//	"quantum" is its length in ticks, SCHED_QUANTUM by default.
+//	"adaptive" makes it follow the CPU bursts instead (see
+//		RecordBurst); "quantum" is then only where it starts.
+//	"precise" ends each quantum with an interrupt of its own, on
+//		the tick it is due, rather than at the first timer
+//		interrupt after it, which is up to TimerTicks late.
+//		With several CPUs, quanta are always checked between
+//		rounds (see cpu.cc).
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetQuantum(int quantum, bool adaptive, bool precise)
+{
+    ASSERT(quantum > 0);
+    baseQuantum = adaptiveQuantum = quantum;
+    adaptiveQuanta = adaptive;
+    preciseQuanta = precise;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RecordBurst
+// 	Under an adaptive quantum, note a CPU burst of "burst" ticks, and
+//	set the quantum to the length within which BurstPercentile
+//	percent of the last BurstWindow bursts ended, between MinQuantum
+//	and MaxQuantum.  So most threads that would give up the CPU soon
+//	get to, and the others are not left to run for much longer than
+//	that.
+//
+//	A burst cut short by the quantum is "censored": all that is known
+//	is that the thread wanted at least "burst", the quantum.  It is
+//	counted at that length, after the bursts that really ended there;
+//	if the percentile falls on one, the quantum was too short for it,
+//	and is doubled.  Leaving these bursts out would only keep the
+//	short ones, and let the quantum shrink for good.
+//
+//	The window is kept both in arrival order, to know which burst to
+//	drop, and sorted, to read the percentile off.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RecordBurst(int burst, bool censored)
+{
+    int key = 2 * burst + (censored ? 1 : 0);
+    int i, n, length;
+
+    if (numBursts == BurstWindow) {
+       // Drop the oldest burst
+       for (i = 0; sortedBursts[i] != recentBursts[nextBurst]; i++)
+          ;
+       for (; i < numBursts - 1; i++)
+          sortedBursts[i] = sortedBursts[i + 1];
+       numBursts--;
+    }
+    recentBursts[nextBurst] = key;
+    nextBurst = (nextBurst + 1) % BurstWindow;
+    for (i = numBursts; (i > 0) && (sortedBursts[i - 1] > key); i--)
+       sortedBursts[i] = sortedBursts[i - 1];
+    sortedBursts[i] = key;
+    numBursts++;
+
+    n = (numBursts * BurstPercentile + 99) / 100;
+    length = sortedBursts[n - 1] / 2;
+    if (sortedBursts[n - 1] % 2)	// censored: too short for it
+       length *= 2;
+    adaptiveQuantum = min(max(length, MinQuantum), MaxQuantum);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartQuantum, Scheduler::EndQuantum,
+// Scheduler::CancelQuantum
+// 	"thread" has just been given the CPU: with precise quanta, set an
+//	interrupt for the tick its quantum is up.  The interrupt of a
+//	thread that gives up the CPU before its quantum is up is
+//	cancelled (see EndBurst), so that it does not hold Idle up; and
+//	every burst gets a new number, so that it could do nothing anyway.
+//	When the interrupt is that of the running burst, make the thread
+//	yield.  A burst that started without one (before the scheduling
+//	algorithm was chosen, say) is left to the timer handler.
+//----------------------------------------------------------------------
+
+static void
+QuantumInterruptHandler(int burst)
+{
+    scheduler->EndQuantum(burst);
+}
+
+void
+Scheduler::StartQuantum(Thread *thread)
+{
+    int quantum;
+
+    quantumBurst++;
+    CancelQuantum();
+    if (!Preemptive())
+       return;
+    quantum = Quantum(thread);
+    stats->numQuanta++;
+    stats->totalQuantum += quantum;
+    if (!QuantumTimer())
+       return;
+    quantumInterrupt = interrupt->Schedule(QuantumInterruptHandler,
+					   quantumBurst, quantum, QuantumInt);
+    armedBurst = quantumBurst;
+}
+
+void
+Scheduler::EndQuantum(int burst)
+{
+    if (burst == armedBurst)
+       quantumInterrupt = NULL;		// it is firing
+    if ((burst != quantumBurst) || (interrupt->getStatus() == IdleMode))
+       return;
+    stats->numQuantumExpiries++;
+    interrupt->YieldOnReturn();
+}
+
+void
+Scheduler::CancelQuantum()
+{
+    if (quantumInterrupt != NULL) {
+       interrupt->Cancel(quantumInterrupt);
+       quantumInterrupt = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::QuantumTimer
+// 	Return TRUE if quanta are ended by an interrupt of their own,
+//	rather than checked at every timer interrupt.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::QuantumTimer()
+{
+#ifdef USER_PROGRAM
+    if (numCPUs > 1)
+       return FALSE;
+#endif
+    return preciseQuanta && Preemptive();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetMLFQ
+// 	Configure the MLFQ scheduler.
+//
+//	"levels" is the number of levels, up to MaxMLFQLevels.
+//	"quanta" are their quanta, highest level first; NULL means
+//		the default, which doubles from SCHED_QUANTUM down the
+//		levels.
+//	"boost" is the number of ticks between two boosts, 0 for none.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetMLFQ (int levels, int *quanta, int boost)
+{
+    ASSERT((levels > 0) && (levels <= MaxMLFQLevels) && (boost >= 0));
+    mlfqLevels = levels;
+    for (int i = 0; i < levels; i++) {
+       mlfqQuantum[i] = (quanta != NULL) ? quanta[i] : (SCHED_QUANTUM << i);
+       ASSERT(mlfqQuantum[i] > 0);
+    }
+    boostPeriod = boost;
+    lastBoost = BoostEpoch();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::BoostEpoch, Scheduler::LevelOf
+// 	Return the number of the current boost period; return the MLFQ
+//	level of "thread", putting it back at level 0 first if there
+//	has been a boost since its level was set.  So a thread that is
+//	not ready when a boost happens catches up with it lazily.
+//----------------------------------------------------------------------
+
+int
+Scheduler::BoostEpoch ()
+{
+    return (boostPeriod > 0) ? (stats->totalTicks / boostPeriod) : 0;
+}
+
+int
+Scheduler::LevelOf (Thread *thread)
+{
+    int epoch = BoostEpoch();
+
+    if ((thread->GetLevelEpoch() != epoch) || (thread->GetLevel() >= mlfqLevels))
+       thread->SetLevel(0, epoch);
+    return thread->GetLevel();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::CheckBoost
+// 	Called by the timer interrupt handler under MLFQ.  If a new boost
+//	period has begun, put all the ready threads back at level 0,
+//	keeping the order in which they would have run.
+//----------------------------------------------------------------------
+
+void
+Scheduler::CheckBoost ()
+{
+    int epoch = BoostEpoch();
+    Thread **waiting;
+    int n;
+
+    if ((schedulingAlgo != MLFQ_SCHED) || (epoch == lastBoost))
+       return;
+    lastBoost = epoch;
+    DEBUG('t', "MLFQ boost at time %d\n", stats->totalTicks);
+    for (int i = 0; i < numQueues; i++) {
+       n = readyHeap[i]->Size();
+       waiting = new Thread*[n];
+       for (int j = 0; j < n; j++)
+          waiting[j] = readyHeap[i]->RemoveMin();
+       for (int j = 0; j < n; j++) {
+          waiting[j]->SetLevel(0, epoch);
+          waiting[j]->SetPriority(0);
+          readyHeap[i]->Insert(waiting[j]);
+       }
+       delete [] waiting;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Weight
+// 	Return the CFS weight of a thread whose nice value is "nice",
+//	from MIN_NICE_PRIORITY (the highest priority) to MAX_NICE_PRIORITY.
+//	The range is spread over the 40 UNIX nice values, -20 to 19,
+//	whose weights are those of Linux: one step is worth about 10% of
+//	the CPU.  Nice 0 has weight CFSNiceZeroWeight.
+//----------------------------------------------------------------------
+
+static int niceWeights[40] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15
+};
+
+int
+Scheduler::Weight (int nice)
+{
+    if (nice < MIN_NICE_PRIORITY)
+       nice = MIN_NICE_PRIORITY;
+    if (nice > MAX_NICE_PRIORITY)
+       nice = MAX_NICE_PRIORITY;
+    return niceWeights[(nice - MIN_NICE_PRIORITY) * 39
+			/ (MAX_NICE_PRIORITY - MIN_NICE_PRIORITY)];
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PlaceWaking
+// 	"thread" is made ready after blocking, or for the first time.
+//	Under CFS, a thread that wakes up starts no further behind the
+//	threads that want to run than half of CFSLatency, whatever it had
+//	before; a new thread starts level with them, so that forking does
+//	not buy a child a head start.  Under stride scheduling, its pass
+//	starts no lower than theirs.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PlaceWaking (Thread *thread)
+{
+    long long floor = minVruntime;
+
+    if ((schedulingAlgo == CFS_SCHED) && (thread->getStatus() != JUST_CREATED))
+       floor -= (long long)(CFSLatency / 2) << VruntimeShift;
+
+    if (thread->GetVruntime() < floor)
+       thread->SetVruntime(floor);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::UpdateMinVruntime
+// 	Move minVruntime up to the least virtual runtime of the threads
+//	that want to run: the ready ones, and "thread", which has just
+//	been charged its burst, if it is "runnable".  With none of them,
+//	"thread" is the last one that ran.
+//----------------------------------------------------------------------
+
+void
+Scheduler::UpdateMinVruntime (Thread *thread, bool runnable)
+{
+    Thread *first;
+    long long least = thread->GetVruntime();
+    bool found = runnable;
+
+    for (int i = 0; i < numQueues; i++) {
+       first = readyHeap[i]->Min();
+       if ((first == NULL) || (found && (first->GetVruntime() >= least)))
+          continue;
+       least = first->GetVruntime();
+       found = TRUE;
+    }
+    if (least > minVruntime)
+       minVruntime = least;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Tickets, Scheduler::TicketsOf
+// 	Return the stride and lottery tickets of a thread whose nice value
+//	is "nice": from 1 at MAX_NICE_PRIORITY, one more for each step of
+//	priority up.  Return those "thread" holds now: its own, and those
+//	lent to it by the threads waiting for it to exit.
+//----------------------------------------------------------------------
+
+int
+Scheduler::Tickets (int nice)
+{
+    if (nice < MIN_NICE_PRIORITY)
+       nice = MIN_NICE_PRIORITY;
+    if (nice > MAX_NICE_PRIORITY)
+       nice = MAX_NICE_PRIORITY;
+    return MAX_NICE_PRIORITY + 1 - nice;
+}
+
+int
+Scheduler::TicketsOf (Thread *thread)
+{
+    return Tickets(thread->GetBasePriority() - DEFAULT_BASE_PRIORITY)
+		+ thread->GetBorrowedTickets();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LendTickets, Scheduler::ReturnTickets
+// 	"from" is about to block in SC_Join until "to" exits: lend "to"
+//	the tickets of "from", so that the work "from" waits for gets its
+//	share of the CPU as well.  When "to" exits, and wakes "from" up,
+//	it gives them back, so that no thread keeps tickets that are not
+//	its own once the join is over.  If "to" waits in a lottery, its
+//	tickets there change too; under stride scheduling, it is charged
+//	a different pass from its next burst on.
+//----------------------------------------------------------------------
+
+void
+Scheduler::LendTickets (Thread *from, Thread *to)
+{
+    from->SetLentTickets(TicketsOf(from));
+    to->SetBorrowedTickets(to->GetBorrowedTickets() + from->GetLentTickets());
+    DEBUG('t', "Thread \"%s\" lends its tickets to \"%s\", now %d\n",
+	  from->getName(), to->getName(), TicketsOf(to));
+    RetuneLottery(to);
+}
+
+void
+Scheduler::ReturnTickets (Thread *from, Thread *to)
+{
+    if (from->GetLentTickets() == 0)
+       return;
+    to->SetBorrowedTickets(to->GetBorrowedTickets() - from->GetLentTickets());
+    from->SetLentTickets(0);
+    DEBUG('t', "Thread \"%s\" gives the tickets of \"%s\" back, now %d\n",
+	  to->getName(), from->getName(), TicketsOf(to));
+    RetuneLottery(to);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RetuneLottery
+// 	The tickets of "thread" have changed: if it waits in a lottery,
+//	it holds the new number there.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RetuneLottery (Thread *thread)
+{
+    if (schedulingAlgo != LOTTERY_SCHED)
+       return;
+    for (int i = 0; i < numQueues; i++) {
+       if (readyLottery[i]->Contains(thread)) {
+          readyLottery[i]->SetTickets(thread, TicketsOf(thread));
+          break;
+       }
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintFairness
+// 	With "-fair", print what each thread got when Nachos halts, under
+//	any scheduling algorithm: its CPU time, and the time it spent in
+//	a ready queue.  How fairly the CPU was shared is measured by the
+//	rate at which each thread got CPU time while it wanted it,
+//	cpu / (cpu + wait), over its weight.  A weighted-fair scheduler
+//	gives them all the same rate/weight, and Jain's index of them is
+//	then 1; at worst it is 1/n.
+//
+//	Under stride or lottery scheduling, each thread's share of the
+//	CPU time the threads got is compared with the share its tickets
+//	entitle it to, among the threads that ran.  A thread's tickets
+//	are the average it held while it ran, the ones it was lent
+//	included (see LendTickets).  The two agree when the threads all
+//	want the CPU for the whole run; a thread that waits, or exits
+//	early, gets less than its entitlement.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintFairness ()
+{
+    unsigned first = excludeMainThread ? 1 : 0;
+    double rate, sum = 0, sumSquares = 0;
+    int n = 0, completed = 0;
+    int totalCPU = 0;
+    double tickets, totalTickets = 0;
+
+    if (!reportFairness)
+       return;
+    printf("\nPer-thread CPU shares:\n");
+    printf("%5s %5s %7s %10s %10s %11s %12s\n", "pid", "nice", "weight",
+	   "cpu", "wait", "completion", "rate/weight");
+    for (unsigned i = first; i < thread_index; i++) {
+       if (exitThreadArray[i])
+          completed++;
+       if (cpuTimeArray[i] == 0)
+          continue;
+       rate = (double)cpuTimeArray[i] / (cpuTimeArray[i] + waitTimeArray[i])
+		* CFSNiceZeroWeight / Weight(niceArray[i]);
+       sum += rate;
+       sumSquares += rate * rate;
+       n++;
+       printf("%5d %5d %7d %10d %10d %11d %12.3f\n", i, niceArray[i],
+	      Weight(niceArray[i]), cpuTimeArray[i], waitTimeArray[i],
+	      completionTimeArray[i], rate);
+    }
+    if (n > 0)
+       printf("Fairness (Jain's index of rate/weight): %.3f\n",
+	      sum * sum / (n * sumSquares));
+    if (stats->totalTicks > 0)
+       printf("Throughput: %.3f threads completed per 1000 ticks\n",
+	      1000.0 * completed / stats->totalTicks);
+
+    if (!Proportional() || (n == 0))
+       return;
+    for (unsigned i = first; i < thread_index; i++) {
+       if (cpuTimeArray[i] == 0)
+          continue;
+       totalCPU += cpuTimeArray[i];
+       totalTickets += (double)ticketTimeArray[i] / cpuTimeArray[i];
+    }
+    printf("\nProportional shares of the CPU time:\n");
+    printf("%5s %7s %10s %8s %8s\n", "pid", "tickets", "cpu", "actual",
+	   "entitled");
+    for (unsigned i = first; i < thread_index; i++) {
+       if (cpuTimeArray[i] == 0)
+          continue;
+       tickets = (double)ticketTimeArray[i] / cpuTimeArray[i];
+       printf("%5d %7.1f %10d %7.2f%% %7.2f%%\n", i, tickets,
+	      cpuTimeArray[i], 100.0 * cpuTimeArray[i] / totalCPU,
+	      100.0 * tickets / totalTickets);
+    }
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
 // 	Return the next thread to be scheduled onto the CPU.
 //	If there are no ready threads, return NULL.
+//
+//	The thread comes from the current CPU's own ready list; if that
+//	is empty, it is stolen from the longest one.
 // Side effect:
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
@@ -96,11 +901,85 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    if ((schedulingAlgo == UNIX_SCHED) || (schedulingAlgo == NON_PREEMPTIVE_SJF)){
-       return (Thread *)readyList->GetMinPriorityThread();
+    int which = LocalQueue();
+    PROFILE(ProfFindNext);
+
+    if (numReady == 0)
+       return NULL;
+    if (queueLength[which] == 0) {
+       which = LongestQueue();
+       stats->numSteals++;
+       DEBUG('t', "CPU %d stealing from the ready list of CPU %d\n",
+	     LocalQueue(), which);
+    }
+    numReady--;
+    return TakeFrom(which);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TakeFrom
+// 	Remove the thread to run next from ready list "which", which must
+//	not be empty: the first one, or the one with the best priority
+//	under the UNIX, SJF, MLFQ and CFS schedulers, in O(log n).
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::TakeFrom (int which)
+{
+    Thread *thread;
+
+    if (schedulingAlgo == LOTTERY_SCHED) {
+       ASSERT(readyLottery[which]->Total() > 0);
+       thread = readyLottery[which]->Holder(Random() % readyLottery[which]->Total());
+       readyLottery[which]->Remove(thread);
+    }
+    else if (ByPriority()) {
+       thread = readyHeap[which]->RemoveMin();
     }
     else {
-       return (Thread *)readyList->Remove();
+       thread = (Thread *)readyList[which]->Remove();
+    }
+    ASSERT(thread != NULL);
+    queueLength[which]--;
+    if (thread->GetDecayIndex() >= 0)
+       StopDecay(thread);
+    if (schedulingAlgo == CFS_SCHED)
+       readyWeight -= Weight(thread->GetBasePriority() - DEFAULT_BASE_PRIORITY);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Balance
+// 	Even out the per-CPU ready lists: move threads from the longest
+//	list to the shortest until no two differ by more than one.
+//	Called periodically (see cpu.cc), which is also when the
+//	imbalance between the lists is measured.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Balance ()
+{
+    int longest, shortest, imbalance;
+    Thread *thread;
+
+    if (numQueues == 1)
+       return;
+    longest = LongestQueue();
+    shortest = ShortestQueue(0);
+    imbalance = queueLength[longest] - queueLength[shortest];
+    stats->numBalancePasses++;
+    stats->totalImbalance += imbalance;
+    if (imbalance > stats->maxImbalance)
+       stats->maxImbalance = imbalance;
+
+    while (queueLength[longest] - queueLength[shortest] > 1) {
+       thread = TakeFrom(longest);
+       Enqueue(shortest, thread);
+       stats->numBalanceMoves++;
+       DEBUG('t', "Moving thread %s from the ready list of CPU %d to CPU %d\n",
+	     thread->getName(), longest, shortest);
+       longest = LongestQueue();
+       shortest = ShortestQueue(0);
     }
 }
 
@@ -114,6 +993,8 @@ Scheduler::FindNextToRun ()
 //	already been changed from running to blocked or ready (depending).
 // Side effect:
 //	The global variable currentThread becomes nextThread.
+//	Under a policy that does not preempt, the timer is moved on to
+//	the next tick with a sleeper to wake (see SkipTimerTicks).
 //
 //	"nextThread" is the thread to be put into the CPU.
 //----------------------------------------------------------------------
@@ -122,10 +1003,19 @@ void
 Scheduler::Run (Thread *nextThread)
 {
     Thread *oldThread = currentThread;
+    PROFILE_NAMED(runProfile, ProfSchedRun);
     
     cpu_burst_start_time = stats->totalTicks;
     nextThread->SetCPUBurstStartTime(cpu_burst_start_time);
-    stats->total_wait_time += (stats->totalTicks - nextThread->GetWaitStartTime());
+    // Kernel threads (no pid) are not counted, and the idle thread of
+    // a CPU never waits in the ready list anyway.  With
+    // several CPUs, the thread may have been made ready by a CPU whose
+    // clock is a little ahead of ours (see cpu.cc), hence the check.
+    if ((nextThread->GetPID() >= 0)
+		&& (stats->totalTicks > nextThread->GetWaitStartTime())) {
+       stats->total_wait_time += (stats->totalTicks - nextThread->GetWaitStartTime());
+       waitTimeArray[nextThread->GetPID()] += (stats->totalTicks - nextThread->GetWaitStartTime());
+    }
 
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (currentThread->space != NULL) {	// if this thread is a user program,
@@ -139,16 +1029,35 @@ Scheduler::Run (Thread *nextThread)
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+#ifdef USER_PROGRAM
+    currentCPU->needResched = FALSE;	    // a fresh quantum
+    if (nextThread->GetPID() >= 0) {
+        currentCPU->numDispatches++;
+        if ((nextThread->GetLastCPU() >= 0)
+		&& (nextThread->GetLastCPU() != currentCPU->id)) {
+            currentCPU->numMigrations++;
+            stats->numMigrations++;
+        }
+        nextThread->SetLastCPU(currentCPU->id);
+    }
+#endif
+    StartQuantum(nextThread);
+    if (!Preemptive())
+       interrupt->SkipTimerTicks();
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
+    TRACE(TraceSched, TR_SWITCH, oldThread->GetPID(), nextThread->GetPID());
     
     // This is a machine-dependent assembly language routine defined 
     // in switch.s.  You may have to think
     // a bit to figure out what happens after this, both from the point
     // of view of the thread and from the perspective of the "outside world".
 
+    PROFILE_END(runProfile);
+    PROFILE_SWITCH();
     _SWITCH(oldThread, nextThread);
+    PROFILE_RESUME();
     
     DEBUG('t', "Now in thread \"%s\"\n", currentThread->getName());
 
@@ -206,8 +1115,18 @@ Scheduler::Tail ()
 void
 Scheduler::Print()
 {
-    printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < numQueues; i++) {
+	if (numQueues > 1)
+	    printf("Ready list of CPU %d contents:\n", i);
+	else
+	    printf("Ready list contents:\n");
+	if (schedulingAlgo == LOTTERY_SCHED)
+	    readyLottery[i]->Mapcar((VoidFunctionPtr) ThreadPrint);
+	else if (ByPriority())
+	    readyHeap[i]->Mapcar((VoidFunctionPtr) ThreadPrint);
+	else
+	    readyList[i]->Mapcar((VoidFunctionPtr) ThreadPrint);
+    }
 }
 
 void
@@ -218,34 +1137,75 @@ Scheduler::SetEmptyReadyQueueStartTime (int ticks)
 
 //-------------------------------------------------------------------------
 // Scheduler::UpdateThreadPriority
-//      Updates the priority of all active threads as in the UNIX scheduler
+//      Updates the priority of all active threads as in the UNIX scheduler:
+//      the current thread is charged its burst, and the usage of every
+//      other thread is halved.
+//
+//      The halving is done lazily.  It only advances the decay epoch;
+//      a thread catches up on the halvings it missed (Thread::DecayUsage)
+//      when it is made ready, or when it next ends a burst.  The only
+//      threads brought up to date at once are the ready ones whose usage
+//      is not yet 0, since their priority orders the ready queue; each
+//      one drops out of that list after a few halvings.  So the cost no
+//      longer grows with every thread ever created.
 //--------------------------------------------------------------------------
 void
 Scheduler::UpdateThreadPriority (void)
 {
-   unsigned i;
    int this_cpu_burst_duration = stats->totalTicks - cpu_burst_start_time;
    ASSERT(this_cpu_burst_duration > 0);
-   unsigned currentPID = currentThread->GetPID();
-
-   // First we update the currentThread priority
-
-   int currentThreadUsage = currentThread->GetUsage();
-   currentThreadUsage = (currentThreadUsage + this_cpu_burst_duration) >> 1;
-   int currentThreadPriority = currentThread->GetBasePriority() + (currentThreadUsage >> 1);
-   currentThread->SetUsage(currentThreadUsage);
-   currentThread->SetPriority(currentThreadPriority);
-
-   // Update everybody else
-
-   for (i=0; i<thread_index; i++) {
-      if ((i != currentPID) && !exitThreadArray[i]) {
-         ASSERT(threadArray[i] != NULL);
-         currentThreadUsage = threadArray[i]->GetUsage();
-         currentThreadUsage = currentThreadUsage >> 1;
-         currentThreadPriority = threadArray[i]->GetBasePriority() + (currentThreadUsage >> 1);
-         threadArray[i]->SetUsage(currentThreadUsage);
-         threadArray[i]->SetPriority(currentThreadPriority);
-      }
+
+   // First we update the currentThread priority: bring it up to date,
+   // charge it the burst, and let the new epoch halve the sum
+
+   currentThread->DecayUsage(decayEpoch);
+   currentThread->SetUsage(currentThread->GetUsage() + this_cpu_burst_duration);
+   decayEpoch++;
+   currentThread->DecayUsage(decayEpoch);
+
+   // The new epoch halves everybody else's usage too; the ready threads
+   // that will still have some are brought up to date now
+
+   for (int i = numDecaying - 1; i >= 0; i--) {
+      Thread *thread = decaying[i];
+
+      thread->DecayUsage(decayEpoch);	// reorders the ready queue
+      if (thread->GetUsage() == 0)
+         StopDecay(thread);
+   }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartDecay, Scheduler::StopDecay
+//      Add a ready thread to the list of those whose usage is to be
+//      decayed at once; take it off again.
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartDecay (Thread *thread)
+{
+   ASSERT(thread->GetDecayIndex() < 0);
+   if (numDecaying == decayRoom) {
+      Thread **bigger = new Thread*[2 * decayRoom];
+
+      for (int i = 0; i < numDecaying; i++)
+         bigger[i] = decaying[i];
+      delete [] decaying;
+      decaying = bigger;
+      decayRoom *= 2;
    }
+   thread->SetDecayIndex(numDecaying);
+   decaying[numDecaying++] = thread;
+}
+
+void
+Scheduler::StopDecay (Thread *thread)
+{
+   int i = thread->GetDecayIndex();
+
+   ASSERT((i >= 0) && (decaying[i] == thread));
+   numDecaying--;
+   decaying[i] = decaying[numDecaying];
+   decaying[i]->SetDecayIndex(i);
+   thread->SetDecayIndex(-1);
 }
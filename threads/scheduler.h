@@ -11,11 +11,88 @@
 
 #include "copyright.h"
 #include "list.h"
+#include "interrupt.h"
 #include "thread.h"
+#include "threadheap.h"
+#include "lottery.h"
+#include "predictor.h"
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// The SJF, UNIX and MLFQ schedulers keep the ready threads in heaps
+// ordered by priority (see threadheap.h) rather than in lists.  The
+// priority of a thread under SJF is the length of its next CPU burst,
+// as predicted by one of the BurstPredictors (see predictor.h).
+//
+// The multi-level feedback queue (MLFQ) scheduler uses the heap with
+// a thread's level as its priority, so that it runs the threads of
+// the highest level (0) first, round-robin within a level.  Every
+// level has a quantum of its own.  A thread that is preempted after
+// using up its whole quantum drops a level; one that blocks first
+// (on SC_Sleep, a page fault, the console) keeps its level, so that
+// I/O-bound threads stay at the top.  Every MLFQBoostPeriod ticks all
+// threads go back to level 0, so CPU-bound ones do not starve.
+//
+// The completely fair scheduler (CFS) charges each thread its CPU time
+// scaled down by a weight that grows with its priority (that is, falls
+// with its nice value), and runs the ready thread that has the least
+// of this virtual runtime; the heap is ordered by it.  Instead of a
+// fixed quantum, a thread's slice is its weight's share of CFSLatency,
+// and no shorter than CFSMinGranularity.  A thread that wakes up
+// starts no further behind than half of CFSLatency, so sleeping does
+// not earn it a long run later; a new thread starts at the least
+// virtual runtime of those that want to run.
+//
+// The stride and lottery schedulers give each thread a share of the
+// CPU in proportion to its tickets, which come from its nice value,
+// as given in the batch file: MAX_NICE_PRIORITY + 1 - nice of them.
+// A thread waiting in SC_Join lends its tickets to the child it waits
+// for.  The stride scheduler charges a thread StrideOne / tickets of
+// pass per tick it runs, and runs the ready thread with the least
+// pass, kept in the heap like a CFS vruntime.  A thread made ready
+// after blocking starts no further behind than the least pass, so its
+// share is of the time it wants the CPU.  The lottery scheduler keeps
+// the ready threads in a LotteryTree (see lottery.h), and runs the
+// holder of a ticket drawn at random: the shares are the same on
+// average, but with no memory.
+//
+// With several simulated CPUs there is one ready list per CPU.  A
+// thread is made ready on the CPU it last ran on, unless that CPU's
+// list is much longer than the shortest one; a CPU whose own list is
+// empty steals from the longest one, and the lists are evened out
+// every BalanceRounds rounds (see cpu.cc).
+
+#define AffinitySlack	2	// how many more threads the list of a
+				// thread's last CPU may hold than the
+				// shortest list, and still get the thread
+#define BalanceRounds	10	// rounds between two load balancing
+				// passes
+
+#define MaxMLFQLevels	8	// MLFQ levels, at most
+#define MLFQLevels	3	// ... by default
+#define MLFQBoostPeriod	5000	// ticks between two boosts, by default
+
+#define CFSLatency	400	// ticks in which every ready thread
+				// should get to run once
+#define CFSMinGranularity 100	// the shortest CFS slice
+#define CFSNiceZeroWeight 1024	// weight of a thread at nice 0 on
+				// the UNIX scale, -20 to 19
+#define VruntimeShift	10	// CFS virtual runtime is kept in
+				// 1/2^VruntimeShift ticks, so that
+				// heavy threads are charged at all
+
+#define BurstWindow	64	// adaptive quantum: the last this many
+				// bursts ...
+#define BurstPercentile	80	// ... this many percent of which it
+				// would let end on their own
+#define MinQuantum	10	// ... but no shorter than this
+#define MaxQuantum	1000	// ... and no longer than this
+
+#define StrideOne	(1 << 20)	// pass a thread with 1 ticket is
+				// charged per tick; large, so that
+				// StrideOne / tickets loses little
 
 class Scheduler {
   public:
@@ -27,16 +104,109 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+    bool HasReadyThreads() { return numReady > 0; }
+					// Is anything waiting to run?
+
+    void SetNumQueues(int n);		// One ready list per CPU
+    void Balance();			// Even out the per-CPU ready lists
 
     void Tail();			// Used by fork()
 
     void SetEmptyReadyQueueStartTime (int ticks);
 
     void UpdateThreadPriority (void);	// Used by the UNIX scheduler
+
+    void EndBurst(Thread *thread, bool preempted);
+					// The current thread leaves the
+					// CPU; charge it the burst
+    bool Preemptive();			// Does the timer end quanta?
+    int Quantum(Thread *thread);	// The length of its quantum
+    bool SetPredictor(char *name);	// Choose the SJF burst predictor
+    void PrintPredictors();		// How well each one did, at halt
+
+    void SetQuantum(int quantum, bool adaptive, bool precise);
+					// Configure the fixed quantum
+    void StartQuantum(Thread *thread);	// It has just been dispatched
+    void EndQuantum(int burst);		// Called by its quantum interrupt
+    bool QuantumTimer();		// Do quanta have interrupts?
+    bool QuantumArmed() { return armedBurst == quantumBurst; }
+					// Has the running burst one?
+
+    void SetMLFQ(int levels, int *quanta, int boost);
+					// Configure the MLFQ scheduler
+    void CheckBoost();			// Called by the timer handler
+
+    static int Weight(int nice);	// CFS weight of a nice value
+    static int Tickets(int nice);	// Stride/lottery tickets of one
+    void LendTickets(Thread *from, Thread *to);
+					// "from" waits for "to" to exit
+    void ReturnTickets(Thread *from, Thread *to);
+					// ... and "to" has exited
+    void SetReportFairness(bool on) { reportFairness = on; }
+    void PrintFairness();		// Per-thread shares, at halt
    
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    List **readyList;  		// queues of threads that are ready to run,
+				// but not running; one per CPU
+    ThreadHeap **readyHeap;	// the same, by priority, for SJF and UNIX
+    LotteryTree **readyLottery;	// the same, by tickets, for lottery
+    int *queueLength;		// number of threads on each of them
+    int numQueues;
+    int numReady;		// on all of them
+
+    bool ByPriority();		// are the heaps in use?
+    bool Proportional();	// stride or lottery?
+    int TicketsOf(Thread *thread);	// its own and those lent to it
+    void RetuneLottery(Thread *thread);	// its tickets have changed
+    void Enqueue(int which, Thread *thread);
+    int LocalQueue();		// the list of the current CPU
+    int ShortestQueue(int prefer);
+    int LongestQueue();
+    Thread *TakeFrom(int which);	// dequeue by the scheduling policy
+
+    unsigned decayEpoch;	// halvings of usage decided on so far
+    Thread **decaying;		// ready threads whose usage is not 0
+    int numDecaying;
+    int decayRoom;		// size of "decaying"
+    void StartDecay(Thread *thread);
+    void StopDecay(Thread *thread);
+
+    BurstPredictor *predictors[MaxPredictors];	// all of them, run
+    int numPredictors;		// side by side under SJF
+    BurstPredictor *predictor;	// the one SJF goes by
+
+    int baseQuantum;		// the quantum, unless adaptive
+    bool adaptiveQuanta;	// does it follow the bursts?
+    int adaptiveQuantum;	// what it is then
+    bool preciseQuanta;		// do quanta have interrupts?
+    int recentBursts[BurstWindow];	// the last bursts, in a ring, as
+				// 2 * length, + 1 if cut short
+    int sortedBursts[BurstWindow];	// the same, shortest first
+    int numBursts;
+    int nextBurst;		// where the next one goes in the ring
+    void RecordBurst(int burst, bool censored);
+    int quantumBurst;		// number of the running burst, for
+				// its quantum interrupt
+    int armedBurst;		// the last burst that was given one
+    PendingInterrupt *quantumInterrupt;	// ... and that interrupt, while
+				// it is pending
+    void CancelQuantum();	// Take it off, if it is
+
+    int mlfqLevels;		// MLFQ levels in use
+    int mlfqQuantum[MaxMLFQLevels];	// the quantum of each
+    int boostPeriod;		// ticks between boosts, 0 for none
+    int lastBoost;		// the last boost period the ready
+				// threads were boosted in
+    int BoostEpoch();		// the current boost period
+    int LevelOf(Thread *thread);	// its level, after any boost
+
+    long long minVruntime;	// CFS and stride: never decreases; a
+				// waking thread is placed relative to it
+    int readyWeight;		// CFS: total weight of ready threads
+    void PlaceWaking(Thread *thread);
+    void UpdateMinVruntime(Thread *thread, bool runnable);
+
+    bool reportFairness;	// print the per-thread shares?
 
     int empty_ready_queue_start_time;
 };
@@ -7,6 +7,8 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "trace.h"
+#include "profile.h"
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -26,10 +28,9 @@ unsigned nextUnallocatedPage;
 
 Thread *threadArray[MAX_THREAD_COUNT];  // Array of thread pointers
 unsigned thread_index;			// Index into this array (also used to assign unique pid)
-bool initializedConsoleSemaphores;
 bool exitThreadArray[MAX_THREAD_COUNT];  //Marks exited threads
 
-TimeSortedWaitQueue *sleepQueueHead;	// Needed to implement SC_Sleep
+TimerWheel *sleepQueue;			// Needed to implement SC_Sleep
 
 int schedulingAlgo;			// Scheduling algorithm to simulate
 int pageAlgo;
@@ -43,6 +44,11 @@ int referenceBit[NumPhysPages]; // reference bit
 
 int cpu_burst_start_time;        // Records the start of current CPU burst
 int completionTimeArray[MAX_THREAD_COUNT];        // Records the completion time of all simulated threads
+int cpuTimeArray[MAX_THREAD_COUNT];		// ... the CPU time each one got
+int waitTimeArray[MAX_THREAD_COUNT];		// ... the time each one waited ready
+int niceArray[MAX_THREAD_COUNT];		// ... and the nice value of each
+long long ticketTimeArray[MAX_THREAD_COUNT];	// ... and its tickets times its
+						// CPU time, burst by burst
 bool excludeMainThread;		// Used by completion time statistics calculation
 
 #ifdef FILESYS_NEEDED
@@ -55,6 +61,10 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+CPU *cpus[MaxCPUs];	// the simulated processors
+int numCPUs;		// how many there are
+CPU *currentCPU;	// the one holding the host
+int roundEnd;		// end of the current round of the CPUs
 #endif
 
 #ifdef NETWORK
@@ -86,52 +96,65 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    TimeSortedWaitQueue *ptr;
     if (interrupt->getStatus() != IdleMode) {
-        // Check the head of the sleep queue
-        while ((sleepQueueHead != NULL) && (sleepQueueHead->GetWhen() <= (unsigned)stats->totalTicks)) {
-           sleepQueueHead->GetThread()->Schedule();
-           ptr = sleepQueueHead;
-           sleepQueueHead = sleepQueueHead->GetNext();
-           delete ptr;
+        // Wake up the sleepers that are due
+        sleepQueue->Advance(stats->totalTicks);
+        scheduler->CheckBoost();
+        if (!scheduler->Preemptive()) {
+           interrupt->SkipTimerTicks();	// no quantum to end: on to
+           return;			// the next sleeper
         }
         //printf("[%d] Timer interrupt.\n", stats->totalTicks);
-        if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-           if ((stats->totalTicks - cpu_burst_start_time) >= SCHED_QUANTUM) {
+#ifdef USER_PROGRAM
+        // With several CPUs, every CPU has its own quantum.  The timer
+        // only fires between rounds (see cpu.cc), when the state of
+        // every CPU is in cpus[]; each CPU reschedules at its next
+        // user instruction.
+        if ((numCPUs > 1) && scheduler->Preemptive()) {
+           for (int i = 0; i < numCPUs; i++) {
+              if ((cpus[i]->thread != cpus[i]->idleThread) && ((stats->totalTicks - cpus[i]->burstStart) >= scheduler->Quantum(cpus[i]->thread))) {
+                 if (!cpus[i]->needResched)
+                    stats->numQuantumExpiries++;
+                 cpus[i]->needResched = TRUE;
+              }
+           }
+           return;
+        }
+#endif
+        // With -pq, a quantum that was started with an interrupt of its
+        // own is ended by it (see Scheduler::StartQuantum)
+        if (scheduler->Preemptive() && !scheduler->QuantumArmed()) {
+           if ((stats->totalTicks - cpu_burst_start_time) >= scheduler->Quantum(currentThread)) {
               ASSERT(cpu_burst_start_time == currentThread->GetCPUBurstStartTime());
+              stats->numQuantumExpiries++;
 	      interrupt->YieldOnReturn();
            }
         }
     }
 }
 
-void printQueue() {
-    List *tempList = new List();
-    int *temp;
+//----------------------------------------------------------------------
+// TraceQueueEntry, TraceQueueContents
+// 	Record the page replacement queue, front first, and for
+//	LRU_CLOCK the clock hand, as trace events.  Only to be called
+//	when TraceQueue events are enabled.
+//----------------------------------------------------------------------
 
-    DEBUG('Q', "\n\tThe queue is: \t");
-    temp = (int *)pageQueue->Remove();
-    while( temp != NULL ) {
-        DEBUG('Q', " %d", *temp);
-        tempList->Append((void *)temp);
-        temp = (int *)pageQueue->Remove();
-    }
+static int queuePosition;
 
-    if(pageAlgo == LRU_CLOCK) {
-        DEBUG('Q', "\n\tReferenceBit: \t");
-        int i;
-        for(i=0; i<NumPhysPages;++i){
-            DEBUG('Q', " %d", referenceBit[i]);
-        }
-        if(LRUClockhand != NULL) {
-            DEBUG('Q', "\n\tLRUClockHandle:  %d", *LRUClockhand);
-        }
-        DEBUG('Q', "\n");
-    }
+static void
+TraceQueueEntry(int frame)
+{
+    TraceEvent(TR_QUEUE_ENTRY, queuePosition++, *(int *)frame);
+}
 
-    // The pageQueue now is the modified pageQueue
-    delete pageQueue;
-    pageQueue = tempList;
+void
+TraceQueueContents()
+{
+    queuePosition = 0;
+    pageQueue->Mapcar(TraceQueueEntry);
+    if ((pageAlgo == LRU_CLOCK) && (LRUClockhand != NULL))
+        TraceEvent(TR_CLOCK_HAND, *LRUClockhand, 0);
 }
 
 // This is a method which implements LRU_CLOCK
@@ -202,7 +225,7 @@ void deleteFromPageQueue(int value) {
     temp = (int *)pageQueue->Remove();
     while( temp != NULL ) {
         if(*temp == value) {
-            DEBUG('q', "deleting the frame %d from pageQueue\n", *temp);
+            TRACE(TraceQueue, TR_QUEUE_DELETE, *temp, 0);
             delete temp;
         } else {
             tempList->Append((void *)temp);
@@ -214,8 +237,8 @@ void deleteFromPageQueue(int value) {
     delete pageQueue;
     pageQueue = tempList;
 
-    DEBUG('Q', "Delete Queue %d\t", value);
-    printQueue();
+    if (Tracing(TraceQueue))
+        TraceQueueContents();
 }
 
 //----------------------------------------------------------------------
@@ -233,9 +256,13 @@ Initialize(int argc, char **argv)
 {
     int argCount, i;
     char* debugArgs = "";
+    char* traceArgs = NULL;	// classes of trace events
+    char* traceFile = NULL;
+    bool profile = FALSE;	// profile the simulator
+    bool everyTick = FALSE;	// take every timer interrupt
+    bool fairness = FALSE;	// print the per-thread CPU shares
     bool randomYield = FALSE;
 
-    initializedConsoleSemaphores = false;
     numPagesAllocated = 0;
     nextUnallocatedPage = 0;
 
@@ -263,13 +290,18 @@ Initialize(int argc, char **argv)
     
     excludeMainThread = FALSE;
 
-    for (i=0; i<MAX_THREAD_COUNT; i++) { threadArray[i] = NULL; exitThreadArray[i] = false; completionTimeArray[i] = -1; }
+    for (i=0; i<MAX_THREAD_COUNT; i++) { threadArray[i] = NULL; exitThreadArray[i] = false; completionTimeArray[i] = -1; cpuTimeArray[i] = waitTimeArray[i] = niceArray[i] = 0; ticketTimeArray[i] = 0; }
     thread_index = 0;
 
-    sleepQueueHead = NULL;
+    sleepQueue = new TimerWheel(0);
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool translateBlocks = FALSE; // run user code with the block translator
+    int tlbEntries = TLBSize;	// number of TLB entries, if there is a TLB
+    int ncpu = 1;		// number of simulated CPUs
+    int cpuSlice = CPUSliceTicks; // length of a round of the CPUs
+    int hostThreads = 1;	// host threads to run them on
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -294,10 +326,46 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-tr")) {
+	    ASSERT(argc > 1);
+	    traceArgs = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tf")) {
+	    ASSERT(argc > 1);
+	    traceFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-prof")) {
+	    profile = TRUE;
+	} else if (!strcmp(*argv, "-ticks")) {
+	    everyTick = TRUE;
+	} else if (!strcmp(*argv, "-fair")) {
+	    fairness = TRUE;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	if (!strcmp(*argv, "-bt"))
+	    translateBlocks = TRUE;
+	if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbEntries = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ncpu")) {
+	    ASSERT(argc > 1);
+	    ncpu = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-slice")) {
+	    ASSERT(argc > 1);
+	    cpuSlice = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-hw")) {
+	    ASSERT(argc > 1);
+	    hostThreads = atoi(*(argv + 1));
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -317,9 +385,13 @@ Initialize(int argc, char **argv)
     }
 
     DebugInit(debugArgs);			// initialize DEBUG messages
+    TraceInit(traceArgs, traceFile);		// and trace events
+    ProfileInit(profile);			// and the host time profile
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
+    interrupt->SetTickless(!everyTick);
     scheduler = new Scheduler();		// initialize the ready queue
+    scheduler->SetReportFairness(fairness);
     //if (randomYield)				// start the timer (if needed)
        timer = new Timer(TimerInterruptHandler, 0, randomYield);
 
@@ -338,7 +410,8 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, translateBlocks, tlbEntries);	// this must come first
+    StartCPUs(ncpu, tlbEntries, cpuSlice, hostThreads);
 #endif
 
 #ifdef FILESYS
@@ -362,11 +435,16 @@ void
 Cleanup()
 {
     printf("\nCleaning up...\n");
+    TraceWrite();
+    ProfilePrint();
 #ifdef NETWORK
     delete postOffice;
 #endif
     
 #ifdef USER_PROGRAM
+    machine = cpus[0]->machine;		// the boot CPU owns the memory
+    for (int i = 0; i < numCPUs; i++)
+	delete cpus[i];
     delete machine;
 #endif
 
@@ -379,6 +457,7 @@ Cleanup()
 #endif
     
     delete timer;
+    delete sleepQueue;
     delete scheduler;
     delete interrupt;
     
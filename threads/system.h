@@ -15,6 +15,7 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "timerwheel.h"
 
 #define MAX_THREAD_COUNT 1000
 #define MAX_BATCH_SIZE 100
@@ -24,6 +25,10 @@
 #define NON_PREEMPTIVE_SJF 	2
 #define ROUND_ROBIN 		3
 #define UNIX_SCHED		4
+#define MLFQ_SCHED		5
+#define CFS_SCHED		6
+#define STRIDE_SCHED		7
+#define LOTTERY_SCHED		8
 
 //Page replacement algorithms
 #define NORMAL 0
@@ -32,7 +37,7 @@
 #define LRU 3
 #define LRU_CLOCK 4
 
-#define SCHED_QUANTUM		100		// If not a multiple of timer interval, quantum will overshoot
+#define SCHED_QUANTUM		100		// Default quantum (-q); unless -pq, it ends at the next timer interrupt
 
 #define INITIAL_TAU		SystemTick	// Initial guess of the burst is set to the overhead of system activity
 #define ALPHA			0.5
@@ -60,7 +65,6 @@ extern int *LRUClockhand; // The clock hand of LRU_CLock
 
 extern Thread *threadArray[];  // Array of thread pointers
 extern unsigned thread_index;                  // Index into this array (also used to assign unique pid)
-extern bool initializedConsoleSemaphores;	// Used to initialize the semaphores for console I/O exactly once
 extern bool exitThreadArray[];		// Marks exited threads
 
 extern int schedulingAlgo;		// Scheduling algorithm to simulate
@@ -72,6 +76,11 @@ extern List* pageQueue ; // This is a list of pages in page replacement
 
 extern int cpu_burst_start_time;	// Records the start of current CPU burst
 extern int completionTimeArray[];	// Records the completion time of all simulated threads
+extern int cpuTimeArray[];		// ... the CPU time each one got
+extern int waitTimeArray[];		// ... the time each one waited ready
+extern int niceArray[];			// ... and the nice value of each
+extern long long ticketTimeArray[];	// ... and its tickets times its
+					// CPU time, burst by burst
 extern bool excludeMainThread;		// Used by completion time statistics calculation
 extern List *freedPages;            // A list of pages freed by SC_Exec
 extern int referenceBit[NumPhysPages]; // An array of reference bits of the pageFrames
@@ -79,27 +88,18 @@ extern int referenceBit[NumPhysPages]; // An array of reference bits of the page
 // This maintains a hashMap of pageTable entries
 extern TranslationEntry *pageEntries[NumPhysPages];
 
-class TimeSortedWaitQueue {		// Needed to implement SC_Sleep
-private:
-   Thread *t;				// Thread pointer of the sleeping thread
-   unsigned when;			// When to wake up
-   TimeSortedWaitQueue *next;		// Build the list
-
-public:
-   TimeSortedWaitQueue (Thread *th,unsigned w) { t = th; when = w; next = NULL; }
-   ~TimeSortedWaitQueue (void) {}
-   
-   Thread *GetThread (void) { return t; }
-   unsigned GetWhen (void) { return when; }
-   TimeSortedWaitQueue *GetNext(void) { return next; }
-   void SetNext (TimeSortedWaitQueue *n) { next = n; }
-};
-
-extern TimeSortedWaitQueue *sleepQueueHead;
+extern TimerWheel *sleepQueue;		// Needed to implement SC_Sleep
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "cpu.h"
 extern Machine* machine;	// user program memory and registers
+				// (of the current CPU)
+extern CPU *cpus[MaxCPUs];	// the simulated processors
+extern int numCPUs;		// how many there are (-ncpu)
+extern CPU *currentCPU;		// the one holding the host
+extern int roundEnd;		// when the current lockstep round of
+				// the CPUs ends
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -19,6 +19,7 @@
 #include "switch.h"
 #include "synch.h"
 #include "system.h"
+#include "threadheap.h"
 
 #define STACK_FENCEPOST 0xdeadbeef	// this is put at the top of the
 					// execution stack, for detecting 
@@ -57,6 +58,14 @@ Thread::Thread(char* threadName, int nice)
 
     childcount = 0;
     waitchild_id = -1;
+    lastCPU = -1;
+    heap = NULL;
+    heapIndex = -1;
+    wheelSlot = -1;
+    level = levelEpoch = 0;
+    vruntime = 0;
+    borrowedTickets = lentTickets = 0;
+    lotterySlot = -1;
 
     for (i=0; i<MAX_CHILD_COUNT; i++) exitedChild[i] = false;
     
@@ -73,10 +82,55 @@ Thread::Thread(char* threadName, int nice)
     }
     schedPriority = basePriority;
     usage = 0;
+    usageEpoch = 0;
+    decayIndex = -1;
 
     if (schedulingAlgo == NON_PREEMPTIVE_SJF) schedPriority = INITIAL_TAU;
 }
 
+//----------------------------------------------------------------------
+// Thread::Thread
+// 	Initialize a kernel thread: the idle thread of a simulated CPU
+//	(see cpu.cc), which is never put on the ready list and never
+//	exits.  It is not a simulated user thread, so it is left out of
+//	threadArray and of all the per-thread statistics; the pid is -1.
+//	A thread that is forked, even one that runs no user program
+//	(such as the postal worker), is created with the constructor
+//	above instead; Fork checks this.
+//
+//	"threadName" is an arbitrary string, useful for debugging.
+//----------------------------------------------------------------------
+
+Thread::Thread(char* threadName)
+{
+    name = new char[1024];
+    sprintf(name,"%s",threadName);
+    stackTop = NULL;
+    stack = NULL;
+    status = JUST_CREATED;
+#ifdef USER_PROGRAM
+    space = NULL;
+#endif
+    pageCache = NULL;
+
+    pid = -1;
+    ppid = -1;
+    childcount = 0;
+    waitchild_id = -1;
+    lastCPU = -1;
+    heap = NULL;
+    heapIndex = -1;
+    wheelSlot = -1;
+    level = levelEpoch = 0;
+    vruntime = 0;
+    borrowedTickets = lentTickets = 0;
+    lotterySlot = -1;
+    basePriority = schedPriority = DEFAULT_BASE_PRIORITY;
+    usage = 0;
+    usageEpoch = 0;
+    decayIndex = -1;
+}
+
 //----------------------------------------------------------------------
 // Thread::~Thread
 // 	De-allocate a thread.
@@ -125,6 +179,7 @@ Thread::Fork(VoidFunctionPtr func, int arg)
 {
     DEBUG('t', "Forking thread \"%s\" with func = 0x%x, arg = %d\n",
 	  name, (int) func, arg);
+    ASSERT(pid >= 0);			// not an idle thread
     
     StackAllocate(func, arg);
 
@@ -210,8 +265,9 @@ Thread::SetChildExitCode (int childpid, int ecode)
 
    if (waitchild_id == (int)i) {
       waitchild_id = -1;
-      // I will wake myself up
+      // I will wake myself up, and have my tickets back
       IntStatus oldLevel = interrupt->SetLevel(IntOff);
+      scheduler->ReturnTickets(this, threadArray[childpid]);
       scheduler->ReadyToRun(this);
       (void) interrupt->SetLevel(oldLevel);
    }
@@ -237,24 +293,7 @@ Thread::Exit (bool terminateSim, int exitcode)
     Thread *nextThread;
 
     if (status == RUNNING) {
-       stats->cpu_time += (stats->totalTicks - cpu_burst_start_time);
-       if ((stats->totalTicks - cpu_burst_start_time) > 0) {
-          stats->cpu_burst_count++;
-          stats->nonpreemptive_switch++;
-          if ((stats->totalTicks - cpu_burst_start_time) > stats->max_cpu_burst) {
-             stats->max_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
-             stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if (schedulingAlgo == UNIX_SCHED) {
-             scheduler->UpdateThreadPriority();
-          }
-          else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
-             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
-             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
-          }
-       }
+       scheduler->EndBurst(this, FALSE);
     }
     status = BLOCKED;
     completionTimeArray[currentThread->GetPID()] = stats->totalTicks;
@@ -267,8 +306,9 @@ Thread::Exit (bool terminateSim, int exitcode)
        }
     }
 
-    // Free the pages associated with this thread
-    if(pageAlgo != NORMAL) {
+    // Free the pages associated with this thread, if it has any (a
+    // ring worker has none left by now, see StopRing in exception.cc)
+    if((pageAlgo != NORMAL) && (currentThread->space != NULL)) {
         currentThread->space->freePages(FALSE);
     }
 
@@ -276,6 +316,11 @@ Thread::Exit (bool terminateSim, int exitcode)
     if (nextThread == NULL) {
        scheduler->SetEmptyReadyQueueStartTime(stats->totalTicks);
     }
+#ifdef USER_PROGRAM
+    if ((nextThread == NULL) && !terminateSim && (numCPUs > 1)) {
+       nextThread = currentCPU->idleThread;	// the other CPUs go on
+    }
+#endif
     while (nextThread == NULL) {
        if (terminateSim) {
           DEBUG('i', "Machine idle.  No interrupts to do.\n");
@@ -328,20 +373,11 @@ Thread::Yield ()
 	scheduler->Run(nextThread);
     }
     else if (schedulingAlgo != UNIX_SCHED) {
-       stats->cpu_time += (stats->totalTicks - cpu_burst_start_time);
-       if ((stats->totalTicks - cpu_burst_start_time) > 0) {
-          stats->cpu_burst_count++;
-          stats->preemptive_switch++;
-          if ((stats->totalTicks - cpu_burst_start_time) > stats->max_cpu_burst) {
-             stats->max_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
-             stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          ASSERT(schedulingAlgo != NON_PREEMPTIVE_SJF);
-       }
+       scheduler->EndBurst(this, TRUE);	// a new burst, maybe at a
+					// lower MLFQ level
        cpu_burst_start_time = stats->totalTicks;
        SetCPUBurstStartTime(cpu_burst_start_time);
+       scheduler->StartQuantum(this);
     }
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -376,30 +412,18 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     if (status == RUNNING) {
-       stats->cpu_time += (stats->totalTicks - cpu_burst_start_time);
-       if ((stats->totalTicks - cpu_burst_start_time) > 0) {
-          stats->cpu_burst_count++;
-          stats->nonpreemptive_switch++;
-          if ((stats->totalTicks - cpu_burst_start_time) > stats->max_cpu_burst) {
-             stats->max_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
-             stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
-          }
-          if (schedulingAlgo == UNIX_SCHED) {
-             scheduler->UpdateThreadPriority();
-          }
-          else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
-             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
-             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
-          }
-       }
+       scheduler->EndBurst(this, FALSE);
     }
     status = BLOCKED;
     nextThread = scheduler->FindNextToRun();
     if (nextThread == NULL) {
        scheduler->SetEmptyReadyQueueStartTime (stats->totalTicks);
     }
+#ifdef USER_PROGRAM
+    if ((nextThread == NULL) && (numCPUs > 1)) {
+       nextThread = currentCPU->idleThread;	// the other CPUs go on
+    }
+#endif
     while (nextThread == NULL) {
 	interrupt->Idle();	// no one to run, wait for an interrupt
         nextThread = scheduler->FindNextToRun();
@@ -525,6 +549,8 @@ Thread::CheckIfChild (int childpid)
 // Thread::JoinWithChild
 //      Called by a thread as a result of SC_Join.
 //      Returns the exit code of the child being joined with.
+//      While it waits, the child gets its tickets (stride and lottery
+//      schedulers), until it exits (see SetChildExitCode).
 //----------------------------------------------------------------------
 
 int
@@ -535,6 +561,7 @@ Thread::JoinWithChild (int whichchild)
       // Put myself to sleep
       waitchild_id = whichchild;
       IntStatus oldLevel = interrupt->SetLevel(IntOff);
+      scheduler->LendTickets(this, threadArray[childpidArray[whichchild]]);
       printf("[pid %d] Before sleep in JoinWithChild.\n", pid);
       Sleep();
       printf("[pid %d] After sleep in JoinWithChild.\n", pid);
@@ -582,46 +609,16 @@ Thread::Startup()
 
 //----------------------------------------------------------------------
 // Thread::SortedInsertInWaitQueue
-//      Called by SC_Sleep before putting the caller thread to sleep
+//      Called by SC_Sleep, and to wait out a page fault, to put the
+//      caller thread to sleep until time "when".  The timer interrupt
+//      handler wakes it up.
 //----------------------------------------------------------------------
 
 void
 Thread::SortedInsertInWaitQueue (unsigned when)
 {
-   TimeSortedWaitQueue *ptr, *prev, *temp;
-
-   if (sleepQueueHead == NULL) {
-      sleepQueueHead = new TimeSortedWaitQueue (this, when);
-      ASSERT(sleepQueueHead != NULL);
-   }
-   else {
-      ptr = sleepQueueHead;
-      prev = NULL;
-      while ((ptr != NULL) && (ptr->GetWhen() <= when)) {
-         prev = ptr;
-         ptr = ptr->GetNext();
-      }
-      if (ptr == NULL) {  // Insert at tail
-         ptr = new TimeSortedWaitQueue (this, when);
-         ASSERT(ptr != NULL);
-         ASSERT(prev->GetNext() == NULL);
-         prev->SetNext(ptr);
-      }
-      else if (prev == NULL) {  // Insert at head
-         ptr = new TimeSortedWaitQueue (this, when);
-         ASSERT(ptr != NULL);
-         ptr->SetNext(sleepQueueHead);
-         sleepQueueHead = ptr;
-      }
-      else {
-         temp = new TimeSortedWaitQueue (this, when);
-         ASSERT(temp != NULL);
-         temp->SetNext(ptr);
-         prev->SetNext(temp);
-      }
-   }
-
    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+   sleepQueue->Insert(this, when);
    //printf("[pid %d] Going to sleep at %d.\n", pid, stats->totalTicks);
    Sleep();
    //printf("[pid %d] Returned from sleep at %d.\n", pid, stats->totalTicks);
@@ -670,6 +667,9 @@ void
 Thread::SetPriority (int p)
 {
    schedPriority = p;
+   if (heap != NULL) {		// waiting in a ready queue ordered by it
+      heap->Update(this);
+   }
 }
     
 int 
@@ -690,6 +690,24 @@ Thread::GetUsage (void)
    return usage;
 }
 
+//----------------------------------------------------------------------
+// Thread::DecayUsage
+//      Apply the halvings of my usage that the UNIX scheduler has
+//      decided on since I was last brought up to date (see
+//      Scheduler::UpdateThreadPriority), and recompute my priority.
+//----------------------------------------------------------------------
+
+void
+Thread::DecayUsage (unsigned epoch)
+{
+   unsigned halvings = epoch - usageEpoch;
+
+   if (halvings == 0) return;
+   usage = (halvings >= 8 * sizeof(int)) ? 0 : (usage >> halvings);
+   usageEpoch = epoch;
+   SetPriority(basePriority + (usage >> 1));
+}
+
 void 
 Thread::initBackupMemory(int size) {
     backupMemory = new char[size];
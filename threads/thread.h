@@ -64,6 +64,10 @@ enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(int arg);	 
 
+class ThreadHeap;			// see threadheap.h
+class TimerWheel;			// see timerwheel.h
+class LotteryTree;			// see lottery.h
+
 // The following class defines a "thread control block" -- which
 // represents a single thread of execution.
 //
@@ -84,6 +88,11 @@ class Thread {
 
   public:
     Thread(char* debugName, int nice);		// initialize a Thread 
+    Thread(char* debugName);		// initialize a kernel thread (the
+					// idle thread of a CPU): it has no
+					// pid, is not counted as a
+					// simulated thread, and cannot
+					// be forked
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
@@ -114,6 +123,8 @@ class Thread {
 
     inline int GetPID (void) { return pid; }
     inline int GetPPID (void) { return ppid; }
+    inline int GetLastCPU (void) { return lastCPU; }
+    inline void SetLastCPU (int cpu) { lastCPU = cpu; }
 
     void SetChildExitCode (int childpid, int exitcode);	// Called by an exiting child thread
 
@@ -132,7 +143,8 @@ class Thread {
 
     void Startup();					// Called by the startup function of SC_Fork to cleanly start a forked child after it is scheduled
 
-    void SortedInsertInWaitQueue (unsigned when);	// Called by SC_Sleep handler
+    void SortedInsertInWaitQueue (unsigned when);	// Sleep until "when"; called
+						// by SC_Sleep and page faults
 
     void SetWaitStartTime (int ticks);
     int GetWaitStartTime (void);
@@ -148,6 +160,22 @@ class Thread {
 
     void SetUsage (int usage);
     int GetUsage (void);
+    void DecayUsage (unsigned epoch);	// Catch up on the UNIX scheduler's
+					// decay, up to "epoch"
+    inline int GetDecayIndex (void) { return decayIndex; }
+    inline void SetDecayIndex (int i) { decayIndex = i; }
+
+    inline long long GetVruntime (void) { return vruntime; } // Used by CFS
+    inline void SetVruntime (long long v) { vruntime = v; }  // and stride
+
+    inline int GetBorrowedTickets (void) { return borrowedTickets; }
+    inline void SetBorrowedTickets (int t) { borrowedTickets = t; }
+    inline int GetLentTickets (void) { return lentTickets; }
+    inline void SetLentTickets (int t) { lentTickets = t; }
+
+    inline int GetLevel (void) { return level; }	// Used by MLFQ
+    inline int GetLevelEpoch (void) { return levelEpoch; }
+    inline void SetLevel (int l, int epoch) { level = l; levelEpoch = epoch; }
     char *pageCache; // This caches the pages in case of replacement
     void initPageCache(int cacheSize); 
 
@@ -172,9 +200,38 @@ class Thread {
 
     int wait_start_time;		// Start tick of wait in ready queue
     int burst_start_time;		// Start of the current CPU burst
+    int lastCPU;			// CPU I last ran on, -1 if none yet
 
     int basePriority, schedPriority, usage;	// Used by the UNIX scheduler
 						// schedPriority is also used to store the next burst estimate
+    unsigned usageEpoch;		// decay epoch "usage" is as of
+    int decayIndex;			// my slot in the scheduler's list
+					// of decaying ready threads, or -1
+
+    long long vruntime;			// my CFS virtual runtime: the CPU
+					// time I got, scaled by my weight,
+					// in 1/2^VruntimeShift ticks; or my
+					// stride scheduling pass
+    int borrowedTickets;		// lent to me by threads joining me
+    int lentTickets;			// lent to the child I am joining
+    int level;				// my MLFQ level, 0 the highest
+    int levelEpoch;			// boost period "level" is as of
+
+    friend class ThreadHeap;
+    ThreadHeap *heap;			// ready queue I am waiting in, if
+					// it is ordered by priority
+    int heapIndex;			// my slot in it
+    unsigned heapOrder;			// when I went into it
+
+    friend class TimerWheel;
+    Thread *wheelNext, *wheelPrev;	// the other threads in my slot of
+					// the sleep queue
+    int wheelSlot;			// that slot, -1 if not asleep in it
+    unsigned wakeTime;			// when I am to wake up
+
+    friend class LotteryTree;
+    int lotterySlot;			// my slot in the lottery I am
+					// waiting in, -1 if none
 
 #ifdef USER_PROGRAM
 // A thread running a user program actually has *two* sets of CPU registers -- 
@@ -0,0 +1,205 @@
+// threadheap.cc
+//	Routines to manage a priority queue of threads.  See threadheap.h.
+//
+//	These routines assume that interrupts are already disabled, as
+//	the scheduler's do.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadheap.h"
+
+//----------------------------------------------------------------------
+// ThreadHeap::ThreadHeap, ThreadHeap::~ThreadHeap
+// 	Initialize an empty heap; de-allocate it.  The threads still in
+//	it, if any, are not de-allocated.
+//----------------------------------------------------------------------
+
+ThreadHeap::ThreadHeap()
+{
+    capacity = InitialHeapSize;
+    heap = new Thread*[capacity];
+    size = 0;
+    nextOrder = 0;
+}
+
+ThreadHeap::~ThreadHeap()
+{
+    for (int i = 0; i < size; i++)
+	heap[i]->heap = NULL;
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Before
+// 	Return TRUE if "a" is to run before "b": it has a lower priority
+//	value, or the same one and a lower virtual runtime, or the same
+//	both and went into the heap first.  CFS and stride scheduling
+//	give every thread the same priority, and are ordered by the
+//	virtual runtime, which does not fit in a priority; the other
+//	policies leave it at 0.  The insertion numbers are compared so
+//	that they may wrap around.
+//----------------------------------------------------------------------
+
+bool
+ThreadHeap::Before(Thread *a, Thread *b)
+{
+    if (a->GetPriority() != b->GetPriority())
+	return a->GetPriority() < b->GetPriority();
+    if (a->GetVruntime() != b->GetVruntime())
+	return a->GetVruntime() < b->GetVruntime();
+    return (int)(a->heapOrder - b->heapOrder) < 0;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Place
+// 	Put "thread" in slot "i", and tell it where it is.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Place(int i, Thread *thread)
+{
+    heap[i] = thread;
+    thread->heapIndex = i;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::SiftUp, ThreadHeap::SiftDown
+// 	Move the thread in slot "i" towards the root (the leaves) until
+//	it is after its parent and before its children.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::SiftUp(int i)
+{
+    Thread *thread = heap[i];
+
+    while (i > 0) {
+	int parent = (i - 1) / 2;
+
+	if (!Before(thread, heap[parent]))
+	    break;
+	Place(i, heap[parent]);
+	i = parent;
+    }
+    Place(i, thread);
+}
+
+void
+ThreadHeap::SiftDown(int i)
+{
+    Thread *thread = heap[i];
+
+    for (;;) {
+	int child = 2 * i + 1;
+
+	if (child >= size)
+	    break;
+	if ((child + 1 < size) && Before(heap[child + 1], heap[child]))
+	    child++;
+	if (!Before(heap[child], thread))
+	    break;
+	Place(i, heap[child]);
+	i = child;
+    }
+    Place(i, thread);
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Insert
+// 	Add "thread", which must not be in any heap, after all the
+//	threads of the same priority already here.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Insert(Thread *thread)
+{
+    ASSERT(thread->heap == NULL);
+    if (size == capacity) {
+	Thread **bigger = new Thread*[2 * capacity];
+
+	for (int i = 0; i < size; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	capacity *= 2;
+    }
+    thread->heap = this;
+    thread->heapOrder = nextOrder++;
+    Place(size, thread);
+    size++;
+    SiftUp(size - 1);
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::RemoveMin
+// 	Take the thread with the lowest priority value off the heap and
+//	return it, or NULL if the heap is empty.
+//----------------------------------------------------------------------
+
+Thread *
+ThreadHeap::RemoveMin()
+{
+    Thread *thread;
+
+    if (size == 0)
+	return NULL;
+    thread = heap[0];
+    Remove(thread);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Remove
+// 	Take "thread", which must be in this heap, off it: the last
+//	thread takes its slot, and is moved up or down from there.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Remove(Thread *thread)
+{
+    int i = thread->heapIndex;
+
+    ASSERT((thread->heap == this) && (heap[i] == thread));
+    thread->heap = NULL;
+    thread->heapIndex = -1;
+    size--;
+    if (i == size)
+	return;
+    Place(i, heap[size]);
+    Update(heap[i]);
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Update
+// 	Restore the order of the heap after the priority of "thread",
+//	which is in it, has changed: decrease-key moves it up, increase-
+//	key down.  It keeps its insertion number.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Update(Thread *thread)
+{
+    int i = thread->heapIndex;
+
+    ASSERT((thread->heap == this) && (heap[i] == thread));
+    if ((i > 0) && Before(thread, heap[(i - 1) / 2]))
+	SiftUp(i);
+    else
+	SiftDown(i);
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Mapcar
+// 	Apply "func" to every thread in the heap, in the order of the
+//	heap array: heap[0] runs next, but the rest are not sorted.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Mapcar(VoidFunctionPtr func)
+{
+    for (int i = 0; i < size; i++)
+	(*func)((int)heap[i]);
+}
@@ -0,0 +1,60 @@
+// threadheap.h
+//	Data structures for a ready queue ordered by thread priority.
+//
+//	The SJF and UNIX schedulers always run the ready thread with
+//	the lowest priority value.  A ThreadHeap keeps the ready threads
+//	in a binary min-heap, so finding and removing that thread, and
+//	adding a new one, take O(log n) instead of a walk over the whole
+//	list.  Each thread knows its place in the heap, so that when its
+//	priority changes while it waits (as the UNIX scheduler's do),
+//	it can be moved up or down in O(log n) as well.
+//
+//	Threads of equal priority come out in the order they went in,
+//	as they did from the list: each thread is stamped with an
+//	insertion number, which breaks ties.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADHEAP_H
+#define THREADHEAP_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define InitialHeapSize	16	// grows by doubling
+
+// The following class defines a priority queue of threads.
+
+class ThreadHeap {
+  public:
+    ThreadHeap();			// Initialize an empty heap
+    ~ThreadHeap();
+
+    void Insert(Thread *thread);	// Add a thread
+    Thread *RemoveMin();		// Take the thread with the lowest
+					// priority off; NULL if empty
+    Thread *Min() { return (size > 0) ? heap[0] : NULL; }
+					// The same, leaving it on
+    void Remove(Thread *thread);	// Take this thread off
+    void Update(Thread *thread);	// Its priority has changed
+    int Size() { return size; }
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every thread,
+					// in the order of the heap array,
+					// not the order they will run in
+
+  private:
+    Thread **heap;			// heap[0] is the minimum; the
+					// children of i are 2i+1 and 2i+2
+    int size;				// threads in the heap
+    int capacity;			// room in "heap"
+    unsigned nextOrder;			// insertion number of the next
+
+    bool Before(Thread *a, Thread *b);	// should a run before b?
+    void Place(int i, Thread *thread);	// put a thread in slot i
+    void SiftUp(int i);
+    void SiftDown(int i);
+};
+
+#endif // THREADHEAP_H
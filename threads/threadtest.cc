@@ -11,6 +11,7 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "threadheap.h"
 
 //----------------------------------------------------------------------
 // SimpleThread
@@ -49,3 +50,189 @@ ThreadTest()
     SimpleThread(0);
 }
 
+
+//----------------------------------------------------------------------
+// ReadyQueueCheck
+// 	Check that the heap picks the same thread as the list it replaced
+//	would have: the first thread, in the order they went in, with the
+//	lowest priority value.  The same threads wait in both; a random
+//	mix of dispatches (take the best one off both, check it is the
+//	same, put it back with a new priority) and priority changes of
+//	waiting threads is done on them.  The priorities are drawn from
+//	a small range, so that there are many ties.
+//----------------------------------------------------------------------
+
+#define CheckThreads	64
+#define CheckOperations	200000
+
+void
+ReadyQueueCheck()
+{
+    Thread *threads[CheckThreads];
+    Thread *fromList, *fromHeap;
+    List *list = new List;
+    ThreadHeap *heap = new ThreadHeap;
+    int i, mismatches = 0;
+
+    for (i = 0; i < CheckThreads; i++) {
+	threads[i] = new Thread("check");
+	threads[i]->SetPriority(Random() % 16);
+	list->Append((void *)threads[i]);
+	heap->Insert(threads[i]);
+    }
+    for (i = 0; i < CheckOperations; i++) {
+	if (Random() % 2) {		// a waiting thread's priority changes
+	    threads[Random() % CheckThreads]->SetPriority(Random() % 16);
+	    continue;
+	}
+	fromList = (Thread *)list->GetMinPriorityThread();
+	fromHeap = heap->RemoveMin();
+	if (fromList != fromHeap) {
+	    mismatches++;
+	    heap->Remove(fromList);	// go on from the list's choice
+	    heap->Insert(fromHeap);
+	}
+	fromList->SetPriority(Random() % 16);
+	list->Append((void *)fromList);
+	heap->Insert(fromList);
+    }
+    printf("Ready queue check: %d operations on %d threads, %d mismatches "
+	   "between the heap and the list\n", CheckOperations, CheckThreads,
+	   mismatches);
+
+    while (heap->RemoveMin() != NULL)
+	;
+    delete heap;
+    delete list;
+    for (i = 0; i < CheckThreads; i++)
+	delete threads[i];
+    ASSERT(mismatches == 0);
+}
+
+//----------------------------------------------------------------------
+// ReadyQueueBenchmark
+// 	Measure the host time of a dispatch under the SJF and UNIX
+//	schedulers, for ready queues of growing length: take the thread
+//	with the best priority off the queue, give it a new priority, and
+//	put it back.  Done both with the old list, which is scanned on
+//	every dispatch, and with the heap that replaced it.
+//----------------------------------------------------------------------
+
+#define BenchDispatches	20000
+
+void
+ReadyQueueBenchmark()
+{
+    static int lengths[] = { 10, 100, 1000, 5000 };
+    Thread **threads;
+    Thread *thread;
+    List *list;
+    ThreadHeap *heap;
+    long long start, listNs, heapNs;
+    int n, i;
+
+    printf("Ready queue dispatch cost (%d dispatches each):\n", BenchDispatches);
+    printf("%8s %14s %14s\n", "threads", "list ns/disp", "heap ns/disp");
+    for (unsigned l = 0; l < sizeof(lengths) / sizeof(int); l++) {
+	n = lengths[l];
+	threads = new Thread*[n];
+	for (i = 0; i < n; i++) {
+	    threads[i] = new Thread("bench");
+	    threads[i]->SetPriority(Random() % 128);
+	}
+
+	list = new List;
+	for (i = 0; i < n; i++)
+	    list->Append((void *)threads[i]);
+	start = HostNanoseconds();
+	for (i = 0; i < BenchDispatches; i++) {
+	    thread = (Thread *)list->GetMinPriorityThread();
+	    thread->SetPriority(Random() % 128);
+	    list->Append((void *)thread);
+	}
+	listNs = HostNanoseconds() - start;
+	delete list;
+
+	heap = new ThreadHeap;
+	for (i = 0; i < n; i++)
+	    heap->Insert(threads[i]);
+	start = HostNanoseconds();
+	for (i = 0; i < BenchDispatches; i++) {
+	    thread = heap->RemoveMin();
+	    thread->SetPriority(Random() % 128);
+	    heap->Insert(thread);
+	}
+	heapNs = HostNanoseconds() - start;
+	while (heap->RemoveMin() != NULL)
+	    ;
+	delete heap;
+
+	printf("%8d %14.1f %14.1f\n", n, (double) listNs / BenchDispatches,
+	       (double) heapNs / BenchDispatches);
+	for (i = 0; i < n; i++)
+	    delete threads[i];
+	delete [] threads;
+    }
+}
+
+//----------------------------------------------------------------------
+// PendingQueueBenchmark
+// 	Measure the host time it takes the interrupt simulation to fire
+//	one device interrupt and schedule the next, with more and more
+//	of them outstanding (as with many network nodes, or many disk
+//	requests in flight): take the earliest off, and put it back at
+//	a random time later.  Done both with the sorted list, which is
+//	walked on every insertion, and with the heap that replaced it.
+//----------------------------------------------------------------------
+
+#define BenchEvents	20000
+
+void
+PendingQueueBenchmark()
+{
+    static int lengths[] = { 10, 100, 1000, 5000 };
+    PendingInterrupt *toOccur;
+    List *list;
+    PendingQueue *queue;
+    long long start, listNs, heapNs;
+    int n, i, when;
+
+    printf("Pending interrupt cost (%d interrupts each):\n", BenchEvents);
+    printf("%8s %14s %14s\n", "pending", "list ns/intr", "heap ns/intr");
+    for (unsigned l = 0; l < sizeof(lengths) / sizeof(int); l++) {
+	n = lengths[l];
+
+	list = new List;
+	for (i = 0; i < n; i++) {
+	    when = Random() % 1000;
+	    list->SortedInsert(new PendingInterrupt(NULL, 0, when, DiskInt),
+			       when);
+	}
+	start = HostNanoseconds();
+	for (i = 0; i < BenchEvents; i++) {
+	    toOccur = (PendingInterrupt *)list->SortedRemove(&when);
+	    toOccur->when = when + 1 + Random() % 1000;
+	    list->SortedInsert(toOccur, toOccur->when);
+	}
+	listNs = HostNanoseconds() - start;
+	while (!list->IsEmpty())
+	    delete (PendingInterrupt *)list->Remove();
+	delete list;
+
+	queue = new PendingQueue;
+	for (i = 0; i < n; i++)
+	    queue->Insert(new PendingInterrupt(NULL, 0, Random() % 1000,
+					       DiskInt));
+	start = HostNanoseconds();
+	for (i = 0; i < BenchEvents; i++) {
+	    toOccur = queue->RemoveMin();
+	    toOccur->when += 1 + Random() % 1000;
+	    queue->Insert(toOccur);
+	}
+	heapNs = HostNanoseconds() - start;
+	delete queue;
+
+	printf("%8d %14.1f %14.1f\n", n, (double) listNs / BenchEvents,
+	       (double) heapNs / BenchEvents);
+    }
+}
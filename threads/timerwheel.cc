@@ -0,0 +1,247 @@
+// timerwheel.cc
+//	Routines to manage the queue of sleeping threads.  See
+//	timerwheel.h.
+//
+//	These routines assume that interrupts are already disabled: the
+//	wheel is advanced by the timer interrupt handler.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "timerwheel.h"
+
+//----------------------------------------------------------------------
+// TimerWheel::TimerWheel, TimerWheel::~TimerWheel
+// 	Initialize an empty wheel, whose first tick to expire is "now";
+//	de-allocate it.  The threads still in it, if any, are not woken.
+//----------------------------------------------------------------------
+
+TimerWheel::TimerWheel(unsigned now)
+{
+    for (int level = 0; level < WheelLevels; level++)
+	for (int slot = 0; slot < WheelSize; slot++)
+	    head[level][slot] = tail[level][slot] = NULL;
+    occupied = 0;
+    current = now;
+    count = 0;
+}
+
+TimerWheel::~TimerWheel()
+{
+    for (int level = 0; level < WheelLevels; level++)
+	for (int slot = 0; slot < WheelSize; slot++)
+	    for (Thread *t = head[level][slot]; t != NULL; t = t->wheelNext)
+		t->wheelSlot = -1;
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::Place
+// 	Append "thread" to the slot for its wakeup time: the one of the
+//	lowest level whose slots above it it shares with the wheel's
+//	clock.  A time already past counts as the current tick.
+//----------------------------------------------------------------------
+
+void
+TimerWheel::Place(Thread *thread)
+{
+    unsigned when = thread->wakeTime;
+    int level, slot;
+
+    if ((int)(when - current) < 0)
+	when = current;
+    for (level = 0; level < WheelLevels - 1; level++)
+	if ((when >> (WheelBits * (level + 1)))
+		== (current >> (WheelBits * (level + 1))))
+	    break;
+    slot = (when >> (WheelBits * level)) & WheelMask;
+
+    thread->wheelSlot = level * WheelSize + slot;
+    thread->wheelNext = NULL;
+    thread->wheelPrev = tail[level][slot];
+    if (tail[level][slot] == NULL)
+	head[level][slot] = thread;
+    else
+	tail[level][slot]->wheelNext = thread;
+    tail[level][slot] = thread;
+    if (level == 0)
+	occupied |= 1ULL << slot;
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::Insert
+// 	Put "thread", which must not be in the wheel, to sleep until
+//	time "when".
+//----------------------------------------------------------------------
+
+void
+TimerWheel::Insert(Thread *thread, unsigned when)
+{
+    ASSERT(thread->wheelSlot < 0);
+    thread->wakeTime = when;
+    Place(thread);
+    count++;
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::Remove
+// 	Take "thread", which must be in the wheel, out of its slot
+//	without waking it up.
+//----------------------------------------------------------------------
+
+void
+TimerWheel::Remove(Thread *thread)
+{
+    int level = thread->wheelSlot / WheelSize;
+    int slot = thread->wheelSlot % WheelSize;
+
+    ASSERT(thread->wheelSlot >= 0);
+    if (thread->wheelPrev == NULL)
+	head[level][slot] = thread->wheelNext;
+    else
+	thread->wheelPrev->wheelNext = thread->wheelNext;
+    if (thread->wheelNext == NULL)
+	tail[level][slot] = thread->wheelPrev;
+    else
+	thread->wheelNext->wheelPrev = thread->wheelPrev;
+    if ((level == 0) && (head[level][slot] == NULL))
+	occupied &= ~(1ULL << slot);
+    thread->wheelSlot = -1;
+    count--;
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::Cascade
+// 	The wheel's clock has reached the start of the current slot of
+//	"level"; move the threads in it to the levels below, in order.
+//----------------------------------------------------------------------
+
+void
+TimerWheel::Cascade(int level)
+{
+    int slot = (current >> (WheelBits * level)) & WheelMask;
+    Thread *thread = head[level][slot];
+    Thread *next;
+
+    head[level][slot] = tail[level][slot] = NULL;
+    for (; thread != NULL; thread = next) {
+	next = thread->wheelNext;
+	Place(thread);
+    }
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::Expire
+// 	Wake up the threads in "slot" of level 0, in the order they were
+//	put there.
+//----------------------------------------------------------------------
+
+void
+TimerWheel::Expire(int slot)
+{
+    Thread *thread = head[0][slot];
+    Thread *next;
+
+    head[0][slot] = tail[0][slot] = NULL;
+    occupied &= ~(1ULL << slot);
+    for (; thread != NULL; thread = next) {
+	next = thread->wheelNext;
+	thread->wheelSlot = -1;
+	count--;
+	thread->Schedule();
+    }
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::Advance
+// 	Wake up every thread whose wakeup time is "now" or earlier, in
+//	order of wakeup time.
+//
+//	The clock stops at every tick with sleepers in level 0, and at
+//	the start of every turn of level 0, to move the threads of the
+//	levels above down; it skips over the empty ticks in between, and
+//	over everything once the wheel is empty.  So a slot of a higher
+//	level is always emptied as soon as the clock reaches it.
+//----------------------------------------------------------------------
+
+void
+TimerWheel::Advance(unsigned now)
+{
+    while ((int)(now - current) >= 0) {
+	int slot, level;
+	unsigned next;
+	unsigned long long later;
+
+	if (count == 0) {
+	    current = now + 1;
+	    return;
+	}
+
+	slot = current & WheelMask;
+	if (occupied & (1ULL << slot))
+	    Expire(slot);
+
+	// On to the next tick with sleepers in this turn, or the next turn
+	later = occupied & ~((2ULL << slot) - 1);
+	if (later == 0) {
+	    next = (current | WheelMask) + 1;
+	} else {
+	    for (next = slot + 1; !(later & (1ULL << next)); next++)
+		;
+	    next += current - slot;
+	}
+	if ((int)(next - now) > 0)
+	    next = now + 1;
+	current = next;
+
+	if ((current & WheelMask) == 0) {
+	    // Find the highest level whose slot starts here, and
+	    // cascade from there down
+	    for (level = 1; level < WheelLevels - 1; level++)
+		if (((current >> (WheelBits * level)) & WheelMask) != 0)
+		    break;
+	    for (; level > 0; level--)
+		Cascade(level);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// TimerWheel::NextWakeup
+// 	Return the earliest wakeup time of the threads in the wheel, or
+//	-1 if there are none.  Used to skip the timer interrupts while
+//	the machine is idle and no thread is due.
+//
+//	The earliest thread is in the first non-empty slot, from the
+//	wheel's clock on, of the lowest level that has one.  A slot of
+//	level 0 holds a single tick; one of a higher level has to be
+//	searched.  A past time counts as the current tick, as in Place.
+//----------------------------------------------------------------------
+
+int
+TimerWheel::NextWakeup()
+{
+    if (count == 0)
+	return -1;
+    for (int level = 0; level < WheelLevels; level++) {
+	int from = (current >> (WheelBits * level)) & WheelMask;
+
+	for (int slot = from; slot < WheelSize; slot++) {
+	    Thread *thread = head[level][slot];
+	    unsigned earliest;
+
+	    if (thread == NULL)
+		continue;
+	    earliest = thread->wakeTime;
+	    for (; thread != NULL; thread = thread->wheelNext)
+		if ((int)(thread->wakeTime - earliest) < 0)
+		    earliest = thread->wakeTime;
+	    if ((int)(earliest - current) < 0)
+		earliest = current;
+	    return earliest;
+	}
+    }
+    ASSERT(FALSE);			// "count" says there is one
+    return -1;
+}
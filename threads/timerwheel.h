@@ -0,0 +1,62 @@
+// timerwheel.h
+//	Data structures for the queue of threads sleeping until a given
+//	time: those in SC_Sleep, and those waiting out a page fault.
+//
+//	A TimerWheel is a hierarchical timing wheel.  Level 0 has one
+//	slot per tick for the next WheelSize ticks; each slot of level 1
+//	covers WheelSize ticks, each of level 2 WheelSize of those, and
+//	so on, so that WheelLevels levels cover any 32-bit time.  A
+//	thread goes into the slot of the lowest level that holds its
+//	wakeup time, in O(1).  Each time the wheel's clock passes into a
+//	new slot of a higher level, the threads in that slot are moved
+//	down to the levels below, which takes O(1) per thread per level.
+//
+//	The list of each slot runs through the threads themselves, so
+//	nothing is allocated to sleep, and a thread can be taken off
+//	again in O(1).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define WheelBits	6
+#define WheelSize	(1 << WheelBits)	// slots per level
+#define WheelMask	(WheelSize - 1)
+#define WheelLevels	6			// WheelLevels * WheelBits >= 32
+
+// The following class defines a queue of threads sorted by wakeup time.
+
+class TimerWheel {
+  public:
+    TimerWheel(unsigned now);		// Initialize an empty wheel,
+					// with its clock at "now"
+    ~TimerWheel();
+
+    void Insert(Thread *thread, unsigned when);
+					// Wake up "thread" at time "when"
+    void Remove(Thread *thread);	// Do not wake it up after all
+    void Advance(unsigned now);		// Wake up every thread due by "now"
+    int NextWakeup();			// When is the next thread due?
+					// -1 if none is asleep
+    bool IsEmpty() { return (count == 0); }
+
+  private:
+    Thread *head[WheelLevels][WheelSize];	// the threads in each slot,
+    Thread *tail[WheelLevels][WheelSize];	// in the order they came in
+    unsigned long long occupied;	// bit i: level 0, slot i is not empty
+    unsigned current;			// the next tick to expire
+    int count;				// threads in the wheel
+
+    void Place(Thread *thread);		// put it in its slot
+    void Cascade(int level);		// move the threads in the current
+					// slot of "level" to lower levels
+    void Expire(int slot);		// wake the threads in a level 0 slot
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,114 @@
+// trace.cc
+//	Routines for event tracing.  See trace.h.
+//
+//	The buffer is written with one fwrite of each part of the ring,
+//	so a trace of the full buffer costs nothing until Nachos halts.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "trace.h"
+
+unsigned traceMask = 0;			// enabled classes of events
+
+static TraceRecord traceBuffer[TraceBufferSize];
+static unsigned traceNext = 0;		// events recorded, ever
+static char *traceFile = NULL;		// where the buffer goes
+
+//----------------------------------------------------------------------
+// TraceInit
+// 	Enable the classes of events whose letters (see trace.h) are in
+//	"classes", "+" meaning all of them, and remember where to write
+//	the buffer.  In a build without USE_TRACE, nothing is enabled,
+//	so that no (empty) trace file is written either.
+//
+//	"classes" -- the letters; NULL means no tracing
+//	"fileName" -- the trace file; NULL means "nachos.trace"
+//----------------------------------------------------------------------
+
+void
+TraceInit(char *classes, char *fileName)
+{
+    char *letters = TraceClassLetters;
+
+    traceMask = 0;
+    traceFile = (fileName != NULL) ? fileName : (char *)"nachos.trace";
+    if (classes == NULL)
+	return;
+#ifndef USE_TRACE
+    printf("Tracing was compiled out; rebuild with -DUSE_TRACE for -tr.\n");
+    return;
+#endif
+    for (int i = 0; letters[i] != '\0'; i++)
+	if ((strchr(classes, letters[i]) != NULL)
+		|| (strchr(classes, '+') != NULL))
+	    traceMask |= 1 << i;
+}
+
+//----------------------------------------------------------------------
+// TraceEvent
+// 	Put an event into the ring buffer, overwriting the oldest one if
+//	it is full.  Only called from the kernel, or with the kernel lock
+//	held, so there is no race on the buffer.
+//----------------------------------------------------------------------
+
+void
+TraceEvent(int event, int arg0, int arg1)
+{
+    TraceRecord *record = &traceBuffer[traceNext & (TraceBufferSize - 1)];
+
+    record->ticks = stats->totalTicks;
+    record->event = event;
+#ifdef USER_PROGRAM
+    record->cpu = (currentCPU != NULL) ? currentCPU->id : 0;
+#else
+    record->cpu = 0;
+#endif
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    traceNext++;
+}
+
+//----------------------------------------------------------------------
+// TraceWrite
+// 	Write what is in the ring buffer to the trace file, oldest event
+//	first.  Called when Nachos halts.
+//----------------------------------------------------------------------
+
+void
+TraceWrite()
+{
+    TraceHeader header;
+    unsigned first;
+    FILE *file;
+
+    if (traceMask == 0)
+	return;
+    file = fopen(traceFile, "wb");
+    if (file == NULL) {
+	printf("Cannot write trace file %s\n", traceFile);
+	return;
+    }
+    header.magic = TraceMagic;
+    if (traceNext > TraceBufferSize) {
+	header.count = TraceBufferSize;
+	header.lost = traceNext - TraceBufferSize;
+    } else {
+	header.count = traceNext;
+	header.lost = 0;
+    }
+    first = header.lost & (TraceBufferSize - 1);
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&traceBuffer[first], sizeof(TraceRecord),
+	   min(header.count, (int)(TraceBufferSize - first)), file);
+    if (first + header.count > TraceBufferSize)
+	fwrite(&traceBuffer[0], sizeof(TraceRecord),
+	       first + header.count - TraceBufferSize, file);
+    fclose(file);
+    printf("%d trace events written to %s (%d older ones lost)\n",
+	   header.count, traceFile, header.lost);
+}
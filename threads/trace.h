@@ -0,0 +1,111 @@
+// trace.h
+//	Event tracing, for the paths that run on every instruction or
+//	memory reference, where a DEBUG call costs too much even when its
+//	flag is off.
+//
+//	A trace point is a TRACE statement, or a block guarded by
+//	Tracing().  When Nachos is compiled without -DUSE_TRACE, both turn
+//	into nothing; with it, a disabled trace point costs one test of
+//	a global mask, and the whole block it guards (argument
+//	computation included) is skipped.
+//
+//	Events are not printed: each one is a fixed-size binary record
+//	put into a ring buffer, which keeps the most recent
+//	TraceBufferSize of them.  The buffer is written to a file when
+//	Nachos halts, and bin/tracedump turns that file into text.
+//
+//	This file is also included by bin/tracedump.c, so the part it
+//	needs is plain C.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Classes of events, enabled with "-tr", one letter each
+#define TraceMemory	0x01	// 'm': address translations
+#define TracePaging	0x02	// 'p': page faults and evictions
+#define TraceQueue	0x04	// 'q': the page replacement queue
+#define TraceSched	0x08	// 's': context switches
+#define TraceClassLetters	"mpqs"	// in the order of the bits
+
+// The events; "arg0" and "arg1" of each are as in its format
+#define TR_TRANSLATE	1	// TraceMemory
+#define TR_TLB_MISS	2
+#define TR_PAGE_FAULT	3	// TracePaging
+#define TR_EVICT	4
+#define TR_WRITE_BACK	5
+#define TR_QUEUE_APPEND	6	// TraceQueue
+#define TR_QUEUE_DELETE	7
+#define TR_QUEUE_REF	8
+#define TR_QUEUE_ENTRY	9
+#define TR_CLOCK_HAND	10
+#define TR_SWITCH	11	// TraceSched
+#define TR_NUM_EVENTS	12
+
+// How the decoder prints each event, indexed by its number
+#define TRACE_EVENT_FORMATS {						\
+    "(none)",								\
+    "translate va 0x%x -> pa 0x%x",					\
+    "TLB miss vpn %d, asid %d",						\
+    "page fault vpn %d -> frame %d",					\
+    "evict frame %d from pid %d",					\
+    "write back vpn %d of pid %d",					\
+    "queue append frame %d",						\
+    "queue delete frame %d",						\
+    "queue reference frame %d",						\
+    "queue entry %d: frame %d",						\
+    "clock hand at frame %d",						\
+    "switch from pid %d to pid %d",					\
+}
+
+// One event, as kept in the buffer and written to the trace file
+typedef struct {
+    int ticks;			// simulated time
+    short event;		// TR_xxx
+    short cpu;			// simulated CPU
+    int arg0;
+    int arg1;
+} TraceRecord;
+
+// The trace file is a header followed by "count" records, oldest
+// first, in host byte order
+#define TraceMagic	0x4e544331	// "NTC1"
+
+typedef struct {
+    int magic;
+    int count;			// records in the file
+    int lost;			// older ones the ring had overwritten
+} TraceHeader;
+
+#define TraceBufferSize	65536	// records, a power of two
+
+#ifdef __cplusplus
+
+extern void TraceInit(char *classes, char *fileName);
+					// Enable the classes of events in
+					// "classes"; NULL leaves all off
+extern void TraceEvent(int event, int arg0, int arg1);
+					// Record an event
+extern void TraceWrite();		// Write the buffer to the trace
+					// file, if tracing was enabled
+
+#ifdef USE_TRACE
+extern unsigned traceMask;		// enabled classes of events
+
+#define Tracing(classes)	(traceMask & (classes))
+#define TRACE(classes, event, arg0, arg1)				\
+    do {								\
+	if (Tracing(classes))						\
+	    TraceEvent(event, arg0, arg1);				\
+    } while (0)
+#else
+#define Tracing(classes)	0
+#define TRACE(classes, event, arg0, arg1)	do { } while (0)
+#endif // USE_TRACE
+
+#endif // __cplusplus
+
+#endif // TRACE_H
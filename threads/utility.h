@@ -11,6 +11,7 @@
 //   	's' -- semaphores, locks, and conditions
 //   	'i' -- interrupt emulation
 //   	'm' -- machine emulation (USER_PROGRAM)
+//   	'b' -- block translator (USER_PROGRAM)
 //   	'd' -- disk emulation (FILESYS)
 //   	'f' -- file system (FILESYS)
 //   	'a' -- address spaces (USER_PROGRAM)
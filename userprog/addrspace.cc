@@ -19,6 +19,10 @@
 #include "system.h"
 #include "addrspace.h"
 
+// Address space IDs are never reused, so a TLB entry left behind by an
+// address space that is gone can never match another one
+static int nextASID = 0;
+
 //----------------------------------------------------------------------
 // SwapHeader
 // 	Do little endian to big endian conversion on the bytes in the 
@@ -58,6 +62,10 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace(OpenFile *executable)
 {
+    softTLB = new SoftTLBEntry[SoftTLBSize];
+    FlushSoftTLB();
+    asid = nextASID++;
+
     if(pageAlgo != NORMAL) {
         unsigned int i, size;
         int threadPid = currentThread->GetPID();
@@ -147,6 +155,8 @@ AddrSpace::AddrSpace(OpenFile *executable)
         // zero out the entire address space, to zero the unitialized data segment 
         // and the stack segment
         bzero(&machine->mainMemory[pageTable[0].physicalPage], size);
+        for (i = 0; i < numPages; i++)
+            machine->InvalidateDecodedPage(pageTable[i].physicalPage);
 
         // then, copy in the code and data segments into memory
         if (noffH.code.size > 0) {
@@ -183,6 +193,10 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
 AddrSpace::AddrSpace(AddrSpace *parentSpace, int threadPid)
 {
+    softTLB = new SoftTLBEntry[SoftTLBSize];
+    FlushSoftTLB();
+    asid = nextASID++;
+
     if(pageAlgo != NORMAL) {
         numPages = parentSpace->GetNumPages();
         countSharedPages = parentSpace->countSharedPages;
@@ -257,6 +271,7 @@ AddrSpace::AddrSpace(AddrSpace *parentSpace, int threadPid)
                 for(j=0; j<PageSize;++j) {
                     machine->mainMemory[startAddrChild+j] = machine->mainMemory[startAddrParent+j];
                 }
+                machine->InvalidateDecodedPage(pageTable[i].physicalPage);
             }
         }
 
@@ -314,6 +329,7 @@ AddrSpace::AddrSpace(AddrSpace *parentSpace, int threadPid)
                 for(j=0; j<PageSize;++j) {
                     machine->mainMemory[startAddrChild+j] = machine->mainMemory[startAddrParent+j];
                 }
+                machine->InvalidateDecodedPage(pageTable[i].physicalPage);
             }
         }
     }
@@ -391,6 +407,7 @@ AddrSpace::createSharedPageTable(int sharedSize, int *pagesCreated)
             pageTable[i].physicalPage = *physicalPageNumber;
             delete physicalPageNumber;
         }
+        machine->InvalidateDecodedPage(pageTable[i].physicalPage);
 
         DEBUG('A', "Creating a shared page %d for %d\n", pageTable[i].physicalPage, 
                 currentThread->GetPID());
@@ -411,6 +428,10 @@ AddrSpace::createSharedPageTable(int sharedSize, int *pagesCreated)
     // allocated right now
     validPages += sharedPages;
 
+    // The page table has moved, drop the translations cached from the old
+    // one
+    FlushSoftTLB();
+
     // Set up the stuff for machine correctly
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages * PageSize;
@@ -440,6 +461,12 @@ AddrSpace::~AddrSpace()
     }
 
     delete pageTable;
+
+    for (i = 0; i < numCPUs; i++)
+        if (cpus[i]->machine->softTLB == softTLB)
+            cpus[i]->machine->softTLB = NULL;
+    delete [] softTLB;
+    ShootdownTLBSpace(asid);
 }
 
 //----------------------------------------------------------------------
@@ -490,13 +517,22 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table and the
+//      soft TLB of this address space.  Each address space keeps its own
+//      soft TLB, so nothing has to be flushed on a context switch.  LRU
+//      must see every access, so it runs without one.
+//
+//      The hardware TLB, if any, is not flushed either: its entries are
+//      tagged with the address space ID, and only those of the current
+//      address space are used.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->softTLB = (pageAlgo == LRU) ? NULL : softTLB;
+    machine->currentASID = asid;
 }
 
 unsigned
@@ -538,6 +574,10 @@ void AddrSpace::freePages(bool deletePT) {
         }
     }
 
+    // None of the cached translations is valid any more
+    FlushSoftTLB();
+    ShootdownTLBSpace(asid);
+
     // delete the pageTable if yes
     if(deletePT) {
         delete pageTable;
@@ -546,3 +586,150 @@ void AddrSpace::freePages(bool deletePT) {
     // Reduce numPagesAllocated to match the number of pages
     numPagesAllocated -= count;
 }
+
+//----------------------------------------------------------------------
+//  AddrSpace::FlushSoftTLB
+//  Forget every translation cached in the soft TLB of this address
+//  space.  Called whenever the page table is replaced or its pages are
+//  freed.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FlushSoftTLB()
+{
+    int i;
+
+    for (i = 0; i < SoftTLBSize; i++)
+        softTLB[i].virtualPage = -1;
+}
+
+//----------------------------------------------------------------------
+//  AddrSpace::FlushSoftTLBPage
+//  Forget the cached translation of virtual page "vpn", if any.  Called
+//  by the page replacement code when the page loses its frame.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::FlushSoftTLBPage(int vpn)
+{
+    SoftTLBEntry *slot = &softTLB[vpn & (SoftTLBSize - 1)];
+
+    if (slot->virtualPage == vpn)
+        slot->virtualPage = -1;
+}
+
+//----------------------------------------------------------------------
+//  UserFrame
+//  Return the physical frame holding virtual page "vpn" of the current
+//  thread, or -1 if there is no such page (or "writing" and it is
+//  read-only).  A page that is not in memory is brought in first, and
+//  the thread then waits out the page fault latency, just as for a
+//  fault taken by the user program (see ExceptionHandler).
+//----------------------------------------------------------------------
+
+static int
+UserFrame(unsigned vpn, bool writing)
+{
+    ExceptionType exception;
+    int physAddr;
+
+    for (;;) {
+        exception = machine->KernelTranslate(vpn * PageSize, &physAddr,
+                                             writing);
+        if (exception == NoException)
+            return physAddr / PageSize;
+        if ((exception != PageFaultException)
+                || !machine->pageTable[vpn].valid)
+            return -1;
+
+        // Paged in; by the time we are back, it may be gone again
+        currentThread->SortedInsertInWaitQueue (1000+stats->totalTicks);
+        stats->numPageFaults++;
+    }
+}
+
+//----------------------------------------------------------------------
+//  CopyFromUser, CopyToUser
+//  Copy "size" bytes between "buffer" in the kernel and "virtAddr" in
+//  the address space of the current thread, a page at a time: each
+//  page is translated (and faulted in) once, then copied with bcopy.
+//  Returns "size", or -1 if part of the range is not mapped, in which
+//  case part of it may have been copied.
+//----------------------------------------------------------------------
+
+int
+CopyFromUser(int virtAddr, char *buffer, int size)
+{
+    int done, offset, chunk, frame;
+
+    if ((virtAddr < 0) || (size < 0))
+        return -1;
+    for (done = 0; done < size; done += chunk) {
+        offset = (virtAddr + done) % PageSize;
+        chunk = min(PageSize - offset, size - done);
+        frame = UserFrame((virtAddr + done) / PageSize, FALSE);
+        if (frame < 0)
+            return -1;
+        bcopy(&machine->mainMemory[frame * PageSize + offset],
+              buffer + done, chunk);
+    }
+    return size;
+}
+
+int
+CopyToUser(int virtAddr, char *buffer, int size)
+{
+    int done, offset, chunk, frame;
+
+    if ((virtAddr < 0) || (size < 0))
+        return -1;
+    for (done = 0; done < size; done += chunk) {
+        offset = (virtAddr + done) % PageSize;
+        chunk = min(PageSize - offset, size - done);
+        frame = UserFrame((virtAddr + done) / PageSize, TRUE);
+        if (frame < 0)
+            return -1;
+        bcopy(buffer + done,
+              &machine->mainMemory[frame * PageSize + offset], chunk);
+        machine->InvalidateDecodedPage(frame);	// it may be code
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------
+//  CopyStringFromUser
+//  Copy the null-terminated string at "virtAddr" in the address space
+//  of the current thread into "buffer", which holds "maxSize" bytes.
+//  A longer string is cut short; the copy is always null-terminated.
+//  Returns the length of the copy, so that maxSize-1 means the string
+//  may go on, or -1 if it runs into an unmapped page.
+//----------------------------------------------------------------------
+
+int
+CopyStringFromUser(int virtAddr, char *buffer, int maxSize)
+{
+    int done, offset, chunk, frame;
+    char *from, *end;
+
+    ASSERT(maxSize > 0);
+    if (virtAddr < 0)
+        return -1;
+    for (done = 0; done < maxSize - 1; done += chunk) {
+        offset = (virtAddr + done) % PageSize;
+        chunk = min(PageSize - offset, maxSize - 1 - done);
+        frame = UserFrame((virtAddr + done) / PageSize, FALSE);
+        if (frame < 0)
+            return -1;
+        from = &machine->mainMemory[frame * PageSize + offset];
+        end = (char *) memchr(from, '\0', chunk);
+        if (end != NULL) {
+            bcopy(from, buffer + done, end - from);
+            done += end - from;
+            buffer[done] = '\0';
+            return done;
+        }
+        bcopy(from, buffer + done, chunk);
+    }
+    buffer[done] = '\0';
+    return done;
+}
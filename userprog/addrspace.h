@@ -21,6 +21,16 @@
 
 extern void deleteFromPageQueue(int value);
 
+// Copy between the kernel and the address space of the current thread.
+// They return the number of bytes copied, or -1 for a bad address.
+extern int CopyFromUser(int virtAddr, char *buffer, int size);
+extern int CopyToUser(int virtAddr, char *buffer, int size);
+extern int CopyStringFromUser(int virtAddr, char *buffer, int maxSize);
+					// Copy a null-terminated string,
+					// at most maxSize-1 characters of
+					// it; the result is always
+					// terminated
+
 class AddrSpace {
   public:
     AddrSpace(OpenFile *executable);	// Create an address space,
@@ -38,6 +48,9 @@ class AddrSpace {
     void RestoreState();		// info on a context switch
     void freePages(bool deletePT);  // frees pages and deletes the pageTable
 
+    void FlushSoftTLB();		// forget all cached translations
+    void FlushSoftTLBPage(int vpn);	// forget the translation of "vpn"
+
     unsigned GetNumPages();
 
     TranslationEntry* GetPageTable();
@@ -45,6 +58,8 @@ class AddrSpace {
     unsigned createSharedPageTable(int sharedSize, int *pagesCreated); // creates a page table with shared
                                     // pages
 
+    int GetASID() { return asid; }
+
     int countSharedPages; // Keeps a count of the number of sharedPages
     int validPages; // a count of the valid pages of the addressSpace
 
@@ -56,6 +71,10 @@ class AddrSpace {
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    SoftTLBEntry *softTLB;		// cached translations of this space,
+					// used by Machine::CachedTranslate
+    int asid;				// address space ID, tags the TLB
+					// entries of this space
                     //
 };
 
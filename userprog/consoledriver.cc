@@ -0,0 +1,126 @@
+// consoledriver.cc
+//	Routines for the console output driver.  See consoledriver.h.
+//
+//	As everywhere else in the kernel, mutual exclusion comes from
+//	turning interrupts off; WriteDone runs in the display's interrupt
+//	handler.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "consoledriver.h"
+
+// Dummy functions because C++ does not allow pointers to member functions
+static void DriverReadAvail(int arg) { }	// no system call reads the
+						// console yet
+static void DriverWriteDone(int arg)
+{ ConsoleDriver *driver = (ConsoleDriver *)arg; driver->WriteDone(); }
+
+//----------------------------------------------------------------------
+// ConsoleDriver::ConsoleDriver
+// 	Initialize the console driver, and the display behind it.
+//
+//	"writeFile" -- UNIX file simulating the display (NULL -> use stdout)
+//----------------------------------------------------------------------
+
+ConsoleDriver::ConsoleDriver(char *writeFile)
+{
+    console = new Console(NULL, writeFile, DriverReadAvail,
+			  DriverWriteDone, (int)this);
+    head = count = 0;
+    busy = FALSE;
+    queued = sent = 0;
+    progress = new Semaphore("console progress", 0);
+    numWaiting = 0;
+}
+
+//----------------------------------------------------------------------
+// ConsoleDriver::~ConsoleDriver
+// 	De-allocate the driver and the display.
+//----------------------------------------------------------------------
+
+ConsoleDriver::~ConsoleDriver()
+{
+    delete console;
+    delete progress;
+}
+
+//----------------------------------------------------------------------
+// ConsoleDriver::PutChars
+// 	Put "count" characters from "buffer" in the ring, and start a
+//	transfer if the display is free.  If it is busy, or the ring is
+//	full, wait for transfers to complete until all the characters
+//	have been handed to the display, so that output comes out in the
+//	order it was written, the kernel's own included.
+//----------------------------------------------------------------------
+
+void
+ConsoleDriver::PutChars(char *buffer, int n)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    unsigned mine = queued;		// how far our characters go
+    int chunk;
+
+    for (;;) {
+	chunk = min(n, ConsoleRingSize - count);
+	for (int i = 0; i < chunk; i++)
+	    ring[(head + count + i) % ConsoleRingSize] = buffer[i];
+	count += chunk;
+	queued += chunk;
+	buffer += chunk;
+	n -= chunk;
+	if (chunk > 0)
+	    mine = queued;
+
+	if (!busy)
+	    StartTransfer();
+	if ((n == 0) && ((int)(sent - mine) >= 0))
+	    break;			// all handed to the display
+	numWaiting++;			// wait for room in the ring, or
+	progress->P();			// for our turn at the display
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// ConsoleDriver::StartTransfer
+// 	Hand the display the characters at the head of the ring, as many
+//	as lie together before the ring wraps around.  The display takes
+//	its own copy, so their room in the ring is free again at once.
+//----------------------------------------------------------------------
+
+void
+ConsoleDriver::StartTransfer()
+{
+    int length = min(count, ConsoleRingSize - head);
+
+    ASSERT(!busy);
+    if (length == 0)
+	return;
+    console->PutChars(&ring[head], length);
+    head = (head + length) % ConsoleRingSize;
+    count -= length;
+    sent += length;
+    busy = TRUE;
+}
+
+//----------------------------------------------------------------------
+// ConsoleDriver::WriteDone
+// 	Called by the display's interrupt handler when a transfer has
+//	completed.  Start the next one, with everything written since,
+//	and let the waiting writers check how far their output got.
+//----------------------------------------------------------------------
+
+void
+ConsoleDriver::WriteDone()
+{
+    busy = FALSE;
+    StartTransfer();
+    while (numWaiting > 0) {
+	numWaiting--;
+	progress->V();
+    }
+}
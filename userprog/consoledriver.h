@@ -0,0 +1,59 @@
+// consoledriver.h
+//	Data structures for the kernel's driver of the console display.
+//
+//	All the console output of user programs goes through a single
+//	driver.  The characters waiting for the display are kept in a
+//	ring buffer; whenever the display is free, everything in the
+//	ring is handed to it in one transfer, which raises one interrupt
+//	when it is done.  So a stream of small writes, from one thread
+//	or several, costs an interrupt per transfer instead of one per
+//	character, and a writer only waits if the display is busy.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CONSOLEDRIVER_H
+#define CONSOLEDRIVER_H
+
+#include "copyright.h"
+#include "console.h"
+#include "synch.h"
+
+#define ConsoleRingSize	1024	// characters waiting for the display
+
+// The following class defines the console output driver.
+
+class ConsoleDriver {
+  public:
+    ConsoleDriver(char *writeFile);	// Initialize the driver and the
+					// display; NULL means stdout
+    ~ConsoleDriver();
+
+    void PutChars(char *buffer, int count);
+					// Write "count" characters; returns
+					// once they are all on their way
+					// to the display
+    void PutChar(char ch) { PutChars(&ch, 1); }
+
+    void WriteDone();			// Internal: the display has
+					// finished a transfer
+
+  private:
+    Console *console;			// the display
+    char ring[ConsoleRingSize];		// characters not yet handed to it
+    int head;				// the first of them
+    int count;				// how many there are
+    bool busy;				// is a transfer in progress?
+
+    unsigned queued;			// characters put in the ring, ever
+    unsigned sent;			// of which handed to the display
+    Semaphore *progress;		// writers wait on it for a transfer
+					// to complete
+    int numWaiting;			// how many writers are waiting
+
+    void StartTransfer();		// hand the display the characters
+					// at the head of the ring
+};
+
+#endif // CONSOLEDRIVER_H
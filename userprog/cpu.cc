@@ -0,0 +1,431 @@
+// cpu.cc
+//	Routines to simulate a shared-memory multiprocessor: starting the
+//	CPUs, handing the host from one CPU to the next, the idle loop,
+//	the kernel lock, and the per-CPU statistics.  See cpu.h for the
+//	model.
+//
+//	A CPU is handed the host by switching to the thread it is
+//	running (or its idle thread), with the same _SWITCH that the
+//	scheduler uses; the globals currentThread, machine and
+//	cpu_burst_start_time always describe the current CPU.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "cpu.h"
+#include "profile.h"
+
+static int kernelLockHolder = -1;	// CPU in the kernel, or -1
+static int sliceTicks;			// length of a round
+static int numRounds;			// rounds ended so far
+
+// The CPUs given to the host workers this round, and how many ticks
+// each of them is to run
+static CPU *parallelCPUs[MaxCPUs];
+static int parallelWanted[MaxCPUs], parallelDone[MaxCPUs];
+static int hostWorkersWanted = 1;	// -hw, capped at the number of CPUs
+
+// The statistics when the current CPU got the host, to charge its
+// slice to it when it gives the host up
+static int sliceUserTicks, sliceSystemTicks, sliceIdleTicks;
+
+//----------------------------------------------------------------------
+// CPU::CPU
+// 	Initialize a simulated CPU.
+//
+//	"cpuId" is its number, 0 for the boot CPU.
+//	"mach" is the Machine simulating its registers and TLB.
+//----------------------------------------------------------------------
+
+CPU::CPU(int cpuId, Machine *mach)
+{
+    id = cpuId;
+    machine = mach;
+    thread = NULL;
+    idleThread = NULL;
+    clock = stats->totalTicks;
+    burstStart = stats->totalTicks;
+    needResched = FALSE;
+    inUserMode = FALSE;
+    userTicks = systemTicks = idleTicks = 0;
+    numDispatches = numMigrations = numKernelEntries = 0;
+    parallelTicks = numStops = 0;
+}
+
+//----------------------------------------------------------------------
+// CPU::~CPU
+// 	De-allocate a CPU.  The boot CPU's Machine is the global
+//	"machine", which is deleted by Cleanup.  The idle thread is not
+//	deleted: when Nachos halts we may be running on its stack.
+//----------------------------------------------------------------------
+
+CPU::~CPU()
+{
+    if (id != 0)
+	delete machine;
+}
+
+//----------------------------------------------------------------------
+// MarkSlice, ChargeSlice
+// 	Remember the statistics when a CPU gets the host, and charge the
+//	difference to it when it gives the host up.
+//----------------------------------------------------------------------
+
+static void
+MarkSlice()
+{
+    sliceUserTicks = stats->userTicks;
+    sliceSystemTicks = stats->systemTicks;
+    sliceIdleTicks = stats->idleTicks;
+}
+
+static void
+ChargeSlice(CPU *cpu)
+{
+    cpu->userTicks += stats->userTicks - sliceUserTicks;
+    cpu->systemTicks += stats->systemTicks - sliceSystemTicks;
+    cpu->idleTicks += stats->idleTicks - sliceIdleTicks;
+    MarkSlice();
+}
+
+//----------------------------------------------------------------------
+// IdleLoop
+// 	The body of the idle thread of a CPU.  Whenever the thread
+//	running on the CPU blocks or exits with nothing else ready, it
+//	switches to this thread, which runs the next thread to be made
+//	ready, or else idles away the rest of the CPU's slice.
+//
+//	"which" is the number of the CPU.
+//----------------------------------------------------------------------
+
+static void
+IdleLoop(int which)
+{
+    Thread *next;
+
+    DEBUG('t', "CPU %d starting its idle loop\n", which);
+    (void) interrupt->SetLevel(IntOff);
+    for (;;) {
+	interrupt->setStatus(SystemMode);
+	AcquireKernelLock();
+	next = scheduler->FindNextToRun();
+	if (next != NULL)
+	    scheduler->Run(next);	// returns when the CPU runs dry
+	ReleaseKernelLock();
+
+	interrupt->setStatus(IdleMode);
+	if (stats->totalTicks < roundEnd) {
+	    stats->idleTicks += roundEnd - stats->totalTicks;
+	    stats->totalTicks = roundEnd;
+	}
+	SwitchCPU();
+    }
+}
+
+//----------------------------------------------------------------------
+// StartCPUs
+// 	Create the simulated CPUs.  The boot CPU (0) is the one we are
+//	running on: its Machine is "machine" and its thread is
+//	currentThread.  With more than one CPU, each gets an idle thread,
+//	which is also what the other CPUs start out running.
+//
+//	"n" is the number of CPUs.
+//	"tlbEntries" is the size of each CPU's TLB, if there is a TLB.
+//	"slice" is the length of a round, in ticks.
+//	"hostThreads" is how many host threads may run CPUs at once.
+//----------------------------------------------------------------------
+
+void
+StartCPUs(int n, int tlbEntries, int slice, int hostThreads)
+{
+    char name[32];
+    int i;
+
+    ASSERT((n >= 1) && (n <= MaxCPUs));
+    ASSERT(slice > 0);
+    numCPUs = n;
+    sliceTicks = slice;
+    if (n > 1)
+	scheduler->SetNumQueues(n);
+    hostWorkersWanted = min(n, hostThreads);	// see ParallelSlicesUsable
+    for (i = 0; i < n; i++) {
+	cpus[i] = new CPU(i, (i == 0) ? machine
+				: new Machine(machine, tlbEntries));
+	if (n > 1) {
+	    sprintf(name, "idle%d", i);
+	    cpus[i]->idleThread = new Thread(name);
+	    cpus[i]->idleThread->StackAllocate(IdleLoop, i);
+	    cpus[i]->thread = cpus[i]->idleThread;
+	}
+    }
+    cpus[0]->thread = currentThread;
+    currentCPU = cpus[0];
+    roundEnd = stats->totalTicks + sliceTicks;
+    MarkSlice();
+}
+
+//----------------------------------------------------------------------
+// RunParallelJob
+// 	A job for the host workers: run the user code of one CPU.
+//----------------------------------------------------------------------
+
+static void
+RunParallelJob(int which)
+{
+    parallelDone[which] =
+	parallelCPUs[which]->machine->RunParallel(parallelWanted[which]);
+}
+
+//----------------------------------------------------------------------
+// ParallelSlicesUsable
+// 	Can the CPUs run their slices on the host workers?  Not with the
+//	hardware TLB, nor with LRU page replacement: neither uses the soft
+//	TLB, so RunParallel could not run a single instruction.  Decided
+//	on the first round, when the page replacement algorithm is known,
+//	and the host workers are started then.
+//----------------------------------------------------------------------
+
+static bool
+ParallelSlicesUsable()
+{
+    static int usable = -1;		// not decided yet
+
+    if (usable < 0) {
+#ifdef USE_TLB
+	usable = FALSE;
+#else
+	usable = (pageAlgo != LRU);
+#endif
+	if (!usable && (hostWorkersWanted > 1))
+	    printf("-hw ignored: the CPUs need the soft TLB to run in "
+		   "parallel, which %s does not use\n",
+#ifdef USE_TLB
+		   "the hardware TLB"
+#else
+		   "LRU page replacement"
+#endif
+		   );
+	else if (usable && (hostWorkersWanted > 1))
+	    StartHostWorkers(hostWorkersWanted);
+    }
+    return usable;
+}
+
+//----------------------------------------------------------------------
+// RunParallelSlices
+// 	Start a round by running the slice of every CPU that is in user
+//	mode on the host workers, as far as it goes without the kernel.
+//	Then, one CPU after the other, do the stores they held back and
+//	charge them the ticks they ran.  Not done while tracing user
+//	code, whose output would come out in any order, nor where
+//	ParallelSlicesUsable says it cannot be.
+//----------------------------------------------------------------------
+
+static void
+RunParallelSlices()
+{
+    int i, n = 0;
+    CPU *cpu;
+
+    if (DebugIsEnabled('m') || DebugIsEnabled('a') || !ParallelSlicesUsable())
+	return;
+    for (i = 0; i < numCPUs; i++) {
+	cpu = cpus[i];
+	if (cpu->inUserMode && !cpu->needResched && (cpu->clock < roundEnd)) {
+	    parallelCPUs[n] = cpu;
+	    parallelWanted[n] = roundEnd - cpu->clock;
+	    n++;
+	}
+    }
+    if (n == 0)
+	return;
+    RunOnHostWorkers(RunParallelJob, n);
+
+    for (i = 0; i < n; i++) {
+	cpu = parallelCPUs[i];
+	cpu->machine->DrainStores();
+	cpu->clock += parallelDone[i];
+	cpu->userTicks += parallelDone[i];
+	cpu->parallelTicks += parallelDone[i];
+	stats->userTicks += parallelDone[i];
+	if (parallelDone[i] < parallelWanted[i])
+	    cpu->numStops++;
+    }
+}
+
+//----------------------------------------------------------------------
+// EndRound
+// 	Called when the last CPU has finished its slice of a round.
+//	Advance the simulated time to the end of the round and deliver
+//	the interrupts that are due; the timer handler marks the CPUs
+//	whose threads have used up their quantum.  Every BalanceRounds
+//	rounds, even out the CPUs' ready lists.  If no CPU has anything
+//	to do, skip ahead to the next interrupt as Interrupt::Idle does
+//	on a uniprocessor (halting if there is none).
+//----------------------------------------------------------------------
+
+static void
+EndRound()
+{
+    bool allIdle = TRUE;
+    int i, before;
+    IntStatus oldLevel;
+
+    stats->totalTicks = roundEnd;
+    for (i = 0; i < numCPUs; i++)
+	if (cpus[i]->thread != cpus[i]->idleThread)
+	    allIdle = FALSE;
+
+    AcquireKernelLock();
+    interrupt->FireDue();
+    if ((++numRounds % BalanceRounds) == 0)
+	scheduler->Balance();
+    if (allIdle && !scheduler->HasReadyThreads()) {
+	before = stats->totalTicks;
+	oldLevel = interrupt->SetLevel(IntOff);
+	interrupt->Idle();		// charges the jump once ...
+	interrupt->RestoreLevel(oldLevel);
+	for (i = 0; i < numCPUs; i++)
+	    cpus[i]->idleTicks += stats->totalTicks - before;
+	stats->idleTicks += (numCPUs - 1) * (stats->totalTicks - before);
+					// ... but every CPU was idle
+    }
+    ReleaseKernelLock();
+
+    for (i = 0; i < numCPUs; i++)
+	if (cpus[i]->clock < stats->totalTicks)
+	    cpus[i]->clock = stats->totalTicks;
+    roundEnd = stats->totalTicks + sliceTicks;
+    RunParallelSlices();
+}
+
+//----------------------------------------------------------------------
+// SwitchCPU
+// 	The current CPU has used up its slice of the round: hand the host
+//	to the next CPU, ending the round after the last one.  Returns
+//	when this CPU's turn comes around again.
+//
+//	Called only at a user instruction boundary or from the idle
+//	loop, so the CPU is never in the middle of kernel code.  Each
+//	CPU has its own interrupt level and machine status; they are
+//	saved here and put back on return.
+//----------------------------------------------------------------------
+
+void
+SwitchCPU()
+{
+    CPU *from = currentCPU;
+    CPU *to = cpus[(from->id + 1) % numCPUs];
+    MachineStatus oldStatus = interrupt->getStatus();
+    IntStatus oldLevel = interrupt->getLevel();
+
+    ASSERT(!KernelLockHeld());
+    ASSERT(threadToBeDestroyed == NULL);
+
+    ChargeSlice(from);
+    from->inUserMode = (oldStatus == UserMode);
+    from->thread = currentThread;
+    from->burstStart = cpu_burst_start_time;
+    from->clock = stats->totalTicks;
+    if (to->id == 0)
+	EndRound();
+
+    currentCPU = to;
+    currentThread = to->thread;
+    machine = to->machine;
+    cpu_burst_start_time = to->burstStart;
+    stats->totalTicks = to->clock;
+    MarkSlice();
+
+    DEBUG('t', "Switching from CPU %d to CPU %d at time %d\n",
+	  from->id, to->id, stats->totalTicks);
+    from->thread->CheckOverflow();
+    PROFILE_SWITCH();
+    _SWITCH(from->thread, to->thread);
+    PROFILE_RESUME();
+
+    interrupt->RestoreLevel(oldLevel);	// we are "from" again
+    interrupt->setStatus(oldStatus);
+}
+
+//----------------------------------------------------------------------
+// AcquireKernelLock, ReleaseKernelLock, KernelLockHeld
+// 	The kernel lock is held by a CPU from its entry into the kernel
+//	(an exception, a reschedule, or the end of a round) until it
+//	returns to user mode or idles.  A CPU only gives up the host
+//	with the lock free, so at most one CPU is ever in the kernel.
+//
+//	The lock belongs to the CPU, not to a thread: a thread that
+//	blocks in the kernel leaves it to whatever that CPU runs next,
+//	and the thread that resumes it is always dispatched from kernel
+//	code that holds the lock.
+//
+//	On a uniprocessor these do nothing.
+//----------------------------------------------------------------------
+
+void
+AcquireKernelLock()
+{
+    if (numCPUs == 1)
+	return;
+    ASSERT(kernelLockHolder == -1);
+    kernelLockHolder = currentCPU->id;
+    currentCPU->numKernelEntries++;
+}
+
+void
+ReleaseKernelLock()
+{
+    if (numCPUs == 1)
+	return;
+    ASSERT(kernelLockHolder == currentCPU->id);
+    kernelLockHolder = -1;
+}
+
+bool
+KernelLockHeld()
+{
+    return (numCPUs > 1) && (kernelLockHolder == currentCPU->id);
+}
+
+//----------------------------------------------------------------------
+// ShootdownTLBFrame, ShootdownTLBSpace
+// 	Drop the TLB entries mapping a physical frame, or belonging to an
+//	address space, from the TLB of every CPU.
+//----------------------------------------------------------------------
+
+void
+ShootdownTLBFrame(int frame)
+{
+    for (int i = 0; i < numCPUs; i++)
+	if (cpus[i]->machine->tlb != NULL)
+	    cpus[i]->machine->InvalidateTLBFrame(frame);
+}
+
+void
+ShootdownTLBSpace(int asid)
+{
+    for (int i = 0; i < numCPUs; i++)
+	if (cpus[i]->machine->tlb != NULL)
+	    cpus[i]->machine->InvalidateTLBSpace(asid);
+}
+
+//----------------------------------------------------------------------
+// PrintCPUStats
+// 	Print the statistics of each CPU, after the global ones.
+//----------------------------------------------------------------------
+
+void
+PrintCPUStats()
+{
+    ChargeSlice(currentCPU);
+    for (int i = 0; i < numCPUs; i++)
+	printf("CPU %d: ticks: user %d (%d on host workers, %d slices cut short), system %d, idle %d; dispatches %d (%d migrated), kernel entries %d\n",
+	       i, cpus[i]->userTicks, cpus[i]->parallelTicks,
+	       cpus[i]->numStops, cpus[i]->systemTicks,
+	       cpus[i]->idleTicks, cpus[i]->numDispatches,
+	       cpus[i]->numMigrations, cpus[i]->numKernelEntries);
+}
@@ -0,0 +1,99 @@
+// cpu.h
+//	Data structures for simulating a shared-memory multiprocessor.
+//
+//	With "-ncpu n", Nachos simulates n CPUs.  Each one has its own
+//	Machine (registers and TLB; physical memory is shared), its own
+//	current thread, its own idle thread, which runs when there is
+//	nothing else to run, and its own ready list in the scheduler.
+//	A CPU with an empty ready list steals from the other CPUs', and
+//	the lists are balanced every few rounds.
+//
+//	The CPUs are run in lockstep rounds, one after the other, on the
+//	host: in each round every CPU executes CPUSliceTicks worth of
+//	instructions from the same starting time, and only then does the
+//	simulated time of the round end.  Pending interrupts are
+//	delivered between rounds.  While a CPU runs, stats->totalTicks is
+//	that CPU's own clock, so each one sees time advance as it would
+//	on its own.
+//
+//	At the start of each round, the CPUs that are running user code
+//	first run their slice in parallel, on host worker threads (-hw),
+//	as far as they can without the kernel (Machine::RunParallel).
+//	Stores to shared pages are held back and done between rounds, in
+//	CPU order, so the result does not depend on the number of host
+//	threads or on how the host schedules them.  Whatever is left of a
+//	slice -- from the first instruction that needs the kernel on --
+//	is then run in turn, as below.  This needs the soft TLB, so it is
+//	not done with the hardware TLB (USE_TLB) or LRU page replacement.
+//
+//	A CPU only hands the host over to the next one at the boundary of
+//	a user instruction or from its idle loop, never while it is in the
+//	kernel.  The kernel is protected by a single lock, held from every
+//	entry into the kernel until the return to user mode; it takes the
+//	place of "interrupts off" as the kernel's mutual exclusion across
+//	CPUs, and is checked with assertions.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CPU_H
+#define CPU_H
+
+#include "copyright.h"
+#include "thread.h"
+#include "machine.h"
+
+#define MaxCPUs		16
+#define CPUSliceTicks	10	// default ticks each CPU runs in one
+				// round; interrupts may be delivered
+				// this late
+
+// The following class defines one simulated processor.
+
+class CPU {
+  public:
+    CPU(int cpuId, Machine *mach);	// Initialize a CPU; "mach" holds
+					// its registers
+    ~CPU();
+
+    int id;				// 0 is the boot CPU
+    Machine *machine;			// registers and TLB of this CPU
+    Thread *thread;			// running here, while this CPU
+					// is not the current one
+    Thread *idleThread;			// runs when nothing else can
+
+    int clock;				// this CPU's time, while it is
+					// not the current one
+    int burstStart;			// its cpu_burst_start_time
+    bool needResched;			// set by the timer: the thread
+					// has used up its quantum
+    bool inUserMode;			// stopped at a user instruction,
+					// so a host worker can go on
+
+    int userTicks;			// statistics, per CPU
+    int systemTicks;
+    int idleTicks;
+    int numDispatches;			// threads switched to
+    int numMigrations;			// of which last ran on another
+					// CPU
+    int numKernelEntries;		// times the kernel lock was taken
+    int parallelTicks;			// user ticks run on host workers
+    int numStops;			// slices a host worker could not
+					// finish
+};
+
+extern void StartCPUs(int n, int tlbEntries, int sliceTicks,
+		      int hostThreads);
+					// Create the CPUs; the boot CPU
+					// runs on "machine"
+extern void SwitchCPU();		// End the current CPU's slice
+extern void AcquireKernelLock();	// Enter the kernel
+extern void ReleaseKernelLock();	// Leave it
+extern bool KernelLockHeld();		// By the current CPU?
+extern void ShootdownTLBFrame(int frame);
+extern void ShootdownTLBSpace(int asid);
+					// Invalidate TLB entries on all CPUs
+extern void PrintCPUStats();		// Print the per-CPU statistics
+
+#endif // CPU_H
@@ -27,9 +27,10 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
-#include "console.h"
+#include "consoledriver.h"
 #include "synch.h"
 #include "synchop.h"
+#include "profile.h"
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -53,10 +54,6 @@
 //	"which" is the kind of exception.  The list of possible exceptions 
 //	are in machine.h.
 //----------------------------------------------------------------------
-static Semaphore *readAvail;
-static Semaphore *writeDone;
-static void ReadAvail(int arg) { readAvail->V(); }
-static void WriteDone(int arg) { writeDone->V(); }
 
 extern void StartProcess (char*);
 extern void StartExec(char*);
@@ -78,457 +75,823 @@ ForkStartFunction (int dummy)
    machine->Run();
 }
 
-static void ConvertIntToHex (unsigned v, Console *console)
+//----------------------------------------------------------------------
+// HandleTLBMiss
+// 	The TLB has no entry for the faulting address: refill one from
+//	the page table of the current address space.  The entry is tagged
+//	with the address space ID, and is write-protected until the page
+//	is dirty, so that the first store traps to HandleTLBWrite and the
+//	dirty bit of the page table stays exact.
+//
+//	If the page is not in memory, it is paged in and FALSE is returned,
+//	so that the caller charges the usual page fault latency; the access
+//	is then retried, misses again and is refilled.  Returns TRUE if the
+//	TLB was refilled and the instruction can simply be retried.
+//----------------------------------------------------------------------
+
+static int nextTLBVictim = 0;	// round robin replacement of TLB entries
+
+static bool
+HandleTLBMiss()
 {
-   unsigned x;
-   if (v == 0) return;
-   ConvertIntToHex (v/16, console);
-   x = v % 16;
-   if (x < 10) {
-      writeDone->P() ;
-      console->PutChar('0'+x);
-   }
-   else {
-      writeDone->P() ;
-      console->PutChar('a'+x-10);
-   }
+    int vaddr = machine->ReadRegister(BadVAddrReg);
+    unsigned vpn = (unsigned) vaddr / PageSize;
+    TranslationEntry *pte, *entry = NULL;
+    int i;
+
+    if (vpn >= currentThread->space->GetNumPages()) {
+        printf("Unexpected user mode exception %d %d\n", AddressErrorException,
+                machine->ReadRegister(2));
+        ASSERT(FALSE);
+    }
+    pte = &machine->pageTable[vpn];
+    if (!pte->valid) {
+        machine->PageIn(vaddr);
+        return FALSE;
+    }
+
+    // Prefer a free entry, otherwise replace round robin
+    for (i = 0; i < machine->tlbSize; i++)
+        if (!machine->tlb[i].valid) {
+            entry = &machine->tlb[i];
+            break;
+        }
+    if (entry == NULL) {
+        entry = &machine->tlb[nextTLBVictim];
+        nextTLBVictim = (nextTLBVictim + 1) % machine->tlbSize;
+    }
+
+    *entry = *pte;
+    entry->use = TRUE;
+    entry->readOnly = pte->readOnly || !pte->dirty;
+    entry->asid = machine->currentASID;
+    pte->use = TRUE;
+    DEBUG('a', "TLB refill: vpn %d -> frame %d, asid %d\n", vpn,
+            pte->physicalPage, entry->asid);
+    return TRUE;
 }
 
-void
-ExceptionHandler(ExceptionType which)
+//----------------------------------------------------------------------
+// HandleTLBWrite
+// 	A store hit a write-protected TLB entry.  If the page itself is
+//	writable, this is the first store to it: mark it dirty in the page
+//	table and in the TLB, and let the store be retried.  Returns FALSE
+//	for a store to a page that really is read-only.
+//----------------------------------------------------------------------
+
+static bool
+HandleTLBWrite()
 {
-    int type = machine->ReadRegister(2);
-    int memval, paddr, vaddr, printval, tempval, exp;
-    unsigned printvalus;	// Used for printing in hex
-    if (!initializedConsoleSemaphores) {
-       readAvail = new Semaphore("read avail", 0);
-       writeDone = new Semaphore("write done", 1);
-       initializedConsoleSemaphores = true;
+    int vaddr = machine->ReadRegister(BadVAddrReg);
+    unsigned vpn = (unsigned) vaddr / PageSize;
+    TranslationEntry *pte;
+    int i;
+
+    if (vpn >= currentThread->space->GetNumPages())
+        return FALSE;
+    pte = &machine->pageTable[vpn];
+    if (!pte->valid || pte->readOnly)
+        return FALSE;
+
+    pte->dirty = TRUE;
+    for (i = 0; i < machine->tlbSize; i++)
+        if (machine->tlb[i].valid && (machine->tlb[i].virtualPage == (int) vpn)
+                && (machine->tlb[i].asid == machine->currentASID)) {
+            machine->tlb[i].readOnly = FALSE;
+            machine->tlb[i].dirty = TRUE;
+        }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Step the user program past the syscall instruction, so that it
+//	does not make the same system call again when it resumes.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+    machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+    machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+}
+
+//----------------------------------------------------------------------
+// System call rings
+// 	A thread that has set up a ring (see syscall.h) gets a worker
+//	thread, which shares its address space.  Submit hands the worker
+//	the requests written since the last one, and the worker runs them
+//	one after the other with the same handlers as the traps, passing
+//	the arguments and the result through its own copy of the user
+//	registers.  Those handlers may block (on the console, SC_Sleep, a
+//	semaphore), so the worker is a thread of the program like any
+//	other: a child of the thread that set the ring up, with a pid of
+//	its own, that is scheduled, charged and counted as such, and
+//	exits when the ring is stopped.  The rings are indexed by the pid
+//	of their owner, and by that of their worker.
+//----------------------------------------------------------------------
+
+#define MaxRingSize	1024	// entries
+
+class RingState {
+  public:
+    RingState(int addr, int n);
+    ~RingState();
+
+    int ringAddr;		// the Ring in user memory
+    int size;			// its number of entries
+    Thread *worker;		// runs the requests
+    Semaphore *work;		// V'ed by Submit
+    unsigned submitted;		// requests handed to the worker, ever
+    unsigned completed;		// of which completed
+    Semaphore *progress;	// V'ed for each waiter when a batch is done
+    int numWaiting;		// threads waiting for the worker
+    bool stopping;		// the worker is to finish
+};
+
+RingState::RingState(int addr, int n)
+{
+    ringAddr = addr;
+    size = n;
+    worker = NULL;
+    work = new Semaphore("ring work", 0);
+    submitted = completed = 0;
+    progress = new Semaphore("ring progress", 0);
+    numWaiting = 0;
+    stopping = FALSE;
+}
+
+RingState::~RingState()
+{
+    delete work;
+    delete progress;
+}
+
+static RingState *rings[MAX_THREAD_COUNT];
+static RingState *workerRings[MAX_THREAD_COUNT];
+
+static void RingWorker(int dummy);	// below, it needs syscallTable
+
+// Read and write one word of user memory, in host byte order
+static bool
+ReadUserWord(int virtAddr, int *value)
+{
+    if (CopyFromUser(virtAddr, (char *)value, 4) == -1)
+        return FALSE;
+    *value = WordToHost(*value);
+    return TRUE;
+}
+
+static bool
+WriteUserWord(int virtAddr, int value)
+{
+    value = WordToMachine(value);
+    return (CopyToUser(virtAddr, (char *)&value, 4) != -1);
+}
+
+//----------------------------------------------------------------------
+// WaitForRing
+// 	Wait until the worker has completed every request handed to it
+//	up to "target".
+//----------------------------------------------------------------------
+
+static void
+WaitForRing(RingState *ring, unsigned target)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while ((int)(ring->completed - target) < 0) {
+        ring->numWaiting++;
+        ring->progress->P();
     }
-    Console *console = new Console(NULL, NULL, ReadAvail, WriteDone, 0);
-    int exitcode;		// Used in SC_Exit
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// StopRing
+// 	Let the current thread's ring drain, and have its worker finish,
+//	before the thread exits or replaces its address space.  The
+//	worker deletes the ring on its way out.  It runs no user code
+//	after this, so it gives up the address space here: the owner may
+//	free it before the worker is switched to again, and Scheduler::Run
+//	must not restore it then.
+//----------------------------------------------------------------------
+
+static void
+StopRing()
+{
+    RingState *ring = rings[currentThread->GetPID()];
+
+    if (ring == NULL)
+        return;
+    WaitForRing(ring, ring->submitted);
+    rings[currentThread->GetPID()] = NULL;
+    ring->stopping = TRUE;
+    ring->worker->space = NULL;
+    ring->work->V();
+}
+
+//----------------------------------------------------------------------
+// ExitThread
+// 	Finish the current thread with "exitcode", for SC_Exit or a ring
+//	worker that is done, and end the simulation if it was the last.
+//	We do not wait for the children to finish.  The children will
+//	continue to run.  We will worry about this when and if we
+//	implement signals.
+//----------------------------------------------------------------------
+
+static void
+ExitThread(int exitcode)
+{
     unsigned i;
-    char buffer[1024];		// Used in SC_Exec
-    int waitpid;		// Used in SC_Join
-    int whichChild;		// Used in SC_Join
-    Thread *child;		// Used by SC_Fork
-    unsigned sleeptime;		// Used by SC_Sleep
-    int sharedSize; // Used by SC_ShmAllocate
-    unsigned sharedMemoryStart; // Used by SC_ShmAllocate
-    int key, id;  //used by SC_SemGet
-    int returnValue; // used by SC_SemOp
-    int adj; //used by SC_SemOp
-    int op; // use by SC_SemCtl
-    int sem; // used by SC_CondOp
-
-    if ((which == SyscallException) && (type == SC_Halt)) {
-	DEBUG('a', "Shutdown, initiated by user program.\n");
-   	interrupt->Halt();
-    }
-    else if ((which == SyscallException) && (type == SC_Exit)) {
-       exitcode = machine->ReadRegister(4);
-       printf("[pid %d]: Exit called. Code: %d\n", currentThread->GetPID(), exitcode);
-       // We do not wait for the children to finish.
-       // The children will continue to run.
-       // We will worry about this when and if we implement signals.
-       exitThreadArray[currentThread->GetPID()] = true;
-
-       // Find out if all threads have called exit
-       for (i=0; i<thread_index; i++) {
-          if (!exitThreadArray[i]) break;
-       }
-       currentThread->Exit(i==thread_index, exitcode);
+
+    exitThreadArray[currentThread->GetPID()] = true;
+
+    // Find out if all threads have called exit
+    for (i=0; i<thread_index; i++) {
+       if (!exitThreadArray[i]) break;
     }
-    else if ((which == SyscallException) && (type == SC_Exec)) {
-       // Copy the executable name into kernel space
-       vaddr = machine->ReadRegister(4);
-
-       // There is a possibility of a PageFault and so we need to reexecute this
-       // instructions until we get a valid value
-       returnValue = FALSE;
-       while(returnValue != TRUE) {
-           returnValue = machine->ReadMem(vaddr, 1, &memval);
-       }
-
-       i = 0;
-       while ((*(char*)&memval) != '\0') {
-          buffer[i] = (*(char*)&memval);
-          i++;
-          vaddr++;
-
-          // There is a possibility of a PageFault and so we need to reexecute this
-          // instructions until we get a valid value
-          returnValue = FALSE;
-          while(returnValue != TRUE) {
-              returnValue = machine->ReadMem(vaddr, 1, &memval);
-          }
-       }
-       buffer[i] = (*(char*)&memval);
-       StartExec(buffer);
-       DEBUG('C', "%s", buffer);
+    currentThread->Exit(i==thread_index, exitcode);
+}
+
+//----------------------------------------------------------------------
+// System call handlers
+// 	One routine per system call, called from ExceptionHandler through
+//	syscallTable below.  The arguments are in r4..r7 and the result,
+//	if any, goes into r2.  Unless its table entry says otherwise, the
+//	PC is advanced after the handler returns.
+//----------------------------------------------------------------------
+
+static ConsoleDriver *consoleDriver;	// used by the Print system calls
+
+static void
+SysHalt()
+{
+    DEBUG('a', "Shutdown, initiated by user program.\n");
+    interrupt->Halt();
+}
+
+static void
+SysExit()
+{
+    int exitcode = machine->ReadRegister(4);
+
+    printf("[pid %d]: Exit called. Code: %d\n", currentThread->GetPID(), exitcode);
+    StopRing();
+    ExitThread(exitcode);
+}
+
+static void
+SysExec()
+{
+    char buffer[1024];
+    int length;
+
+    // Copy the executable name into kernel space
+    length = CopyStringFromUser(machine->ReadRegister(4), buffer, sizeof(buffer));
+    if ((length < 0) || (length == sizeof(buffer) - 1)) {
+       printf("[pid %d] Exec: bad file name.\n", currentThread->GetPID());
+       return;
     }
-    else if ((which == SyscallException) && (type == SC_Join)) {
-       waitpid = machine->ReadRegister(4);
-       // Check if this is my child. If not, return -1.
-       whichChild = currentThread->CheckIfChild (waitpid);
-       if (whichChild == -1) {
-          printf("[pid %d] Cannot join with non-existent child [pid %d].\n", currentThread->GetPID(), waitpid);
-          machine->WriteRegister(2, -1);
-          // Advance program counters.
-          machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-          machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-          machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-       }
-       else {
-          exitcode = currentThread->JoinWithChild (whichChild);
-          machine->WriteRegister(2, exitcode);
-          // Advance program counters.
-          machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-          machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-          machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-       }
+    StopRing();
+    StartExec(buffer);		// only returns if the file cannot be opened
+    DEBUG('C', "%s", buffer);
+}
+
+static void
+SysJoin()
+{
+    int waitpid = machine->ReadRegister(4);
+    int whichChild, exitcode;
+
+    // Check if this is my child. If not, return -1.
+    whichChild = currentThread->CheckIfChild (waitpid);
+    if (whichChild == -1) {
+       printf("[pid %d] Cannot join with non-existent child [pid %d].\n", currentThread->GetPID(), waitpid);
+       machine->WriteRegister(2, -1);
     }
-    else if ((which == SyscallException) && (type == SC_Fork)) {
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-       
-       child = new Thread("Forked thread", GET_NICE_FROM_PARENT);
-       child->space = new AddrSpace (currentThread->space, child->GetPID());  // Duplicates the address space
-       child->SaveUserState ();		     		      // Duplicate the register set
-       child->ResetReturnValue ();			     // Sets the return register to zero
-       child->StackAllocate (ForkStartFunction, 0);	// Make it ready for a later context switch
-       child->Schedule ();
-       machine->WriteRegister(2, child->GetPID());		// Return value for parent
+    else {
+       exitcode = currentThread->JoinWithChild (whichChild);
+       machine->WriteRegister(2, exitcode);
     }
-    else if ((which == SyscallException) && (type == SC_Yield)) {
+}
+
+static void
+SysFork()
+{
+    Thread *child;
+
+    // The child starts out with a copy of our registers, so they must
+    // already point past the syscall
+    AdvancePC();
+
+    child = new Thread("Forked thread", GET_NICE_FROM_PARENT);
+    child->space = new AddrSpace (currentThread->space, child->GetPID());  // Duplicates the address space
+    child->SaveUserState ();		     		      // Duplicate the register set
+    child->ResetReturnValue ();			     // Sets the return register to zero
+    child->StackAllocate (ForkStartFunction, 0);	// Make it ready for a later context switch
+    child->Schedule ();
+    machine->WriteRegister(2, child->GetPID());		// Return value for parent
+}
+
+static void
+SysYield()
+{
+    currentThread->Yield();
+}
+
+static void
+SysPrintInt()
+{
+    char buffer[16];
+
+    sprintf(buffer, "%d", machine->ReadRegister(4));
+    consoleDriver->PutChars(buffer, strlen(buffer));
+}
+
+static void
+SysPrintChar()
+{
+    consoleDriver->PutChar(machine->ReadRegister(4));
+}
+
+static void
+SysPrintString()
+{
+    char buffer[PageSize + 1];
+    int vaddr = machine->ReadRegister(4);
+    int length;
+
+    // Copy the string in and print it a piece at a time
+    do {
+       length = CopyStringFromUser(vaddr, buffer, sizeof(buffer));
+       if (length > 0)
+          consoleDriver->PutChars(buffer, length);
+       vaddr += length;
+    } while (length == sizeof(buffer) - 1);
+}
+
+static void
+SysGetReg()
+{
+    machine->WriteRegister(2, machine->ReadRegister(machine->ReadRegister(4))); // Return value
+}
+
+static void
+SysGetPA()
+{
+    machine->WriteRegister(2, machine->GetPA(machine->ReadRegister(4)));  // Return value
+}
+
+static void
+SysGetPID()
+{
+    machine->WriteRegister(2, currentThread->GetPID());
+}
+
+static void
+SysGetPPID()
+{
+    machine->WriteRegister(2, currentThread->GetPPID());
+}
+
+static void
+SysSleep()
+{
+    unsigned sleeptime = machine->ReadRegister(4);
+
+    if (sleeptime == 0) {
+       // emulate a yield
        currentThread->Yield();
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
     }
-    else if ((which == SyscallException) && (type == SC_PrintInt)) {
-       printval = machine->ReadRegister(4);
-       if (printval == 0) {
-          writeDone->P() ;
-          console->PutChar('0');
-       }
-       else {
-          if (printval < 0) {
-             writeDone->P() ;
-             console->PutChar('-');
-             printval = -printval;
-          }
-          tempval = printval;
-          exp=1;
-          while (tempval != 0) {
-             tempval = tempval/10;
-             exp = exp*10;
-          }
-          exp = exp/10;
-          while (exp > 0) {
-             writeDone->P() ;
-             console->PutChar('0'+(printval/exp));
-             printval = printval % exp;
-             exp = exp/10;
-          }
-       }
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    else {
+       currentThread->SortedInsertInWaitQueue (sleeptime+stats->totalTicks);
     }
-    else if ((which == SyscallException) && (type == SC_PrintChar)) {
-        writeDone->P() ;        // wait for previous write to finish
-        console->PutChar(machine->ReadRegister(4));   // echo it!
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+}
+
+static void
+SysTime()
+{
+    machine->WriteRegister(2, stats->totalTicks);
+}
+
+static void
+SysPrintIntHex()
+{
+    char buffer[16];
+
+    sprintf(buffer, "0x%x", (unsigned)machine->ReadRegister(4));
+    consoleDriver->PutChars(buffer, strlen(buffer));
+}
+
+static void
+SysShmAllocate()
+{
+    int sharedSize = machine->ReadRegister(4);
+    unsigned sharedMemoryStart;
+    int pagesCreated;
+
+    // create a new Page table with shared pages
+    sharedMemoryStart = (unsigned)currentThread->space->createSharedPageTable(sharedSize, &pagesCreated);
+
+    // Increment the number of page faults
+    stats->numPageFaults += pagesCreated;
+
+    // Return the starting address of the shared memory region
+    machine->WriteRegister(2, sharedMemoryStart);
+}
+
+static void
+SysSemGet()
+{
+    // Obtain the Key
+    int key = machine->ReadRegister(4);
+    int id, i;
+
+    // Check if the semaphore exists, if so then just return the value
+    // otherwise we will have to create a new semaphore
+    id = -1;
+    for( i = 0; i<semaphore_count; ++i ) {
+        if( semaphore_list[i] == key ) {
+            id = i;
+        }
     }
-    else if ((which == SyscallException) && (type == SC_PrintString)) {
-       vaddr = machine->ReadRegister(4);
-
-       // There is a possibility of a PageFault and so we need to reexecute this
-       // instructions until we get a valid value
-       returnValue = FALSE;
-       while(returnValue != TRUE) {
-           returnValue = machine->ReadMem(vaddr, 1, &memval);
-       }
-
-       while ((*(char*)&memval) != '\0') {
-          writeDone->P() ;
-          console->PutChar(*(char*)&memval);
-          vaddr++;
-
-          // There is a possibility of a PageFault and so we need to reexecute this
-          // instructions until we get a valid value
-          returnValue = FALSE;
-          while(returnValue != TRUE) {
-              returnValue = machine->ReadMem(vaddr, 1, &memval);
-          }
-       }
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+
+    // If we have to create a new semaphore, we make sure that we disable
+    // interrupts, the reason being that semaphore_count is a global
+    // variable and so is the semaphores array
+    // If the semaphore does not exists then create a new one
+    if ( id == -1 ) {
+        IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+    
+        id = semaphore_count;
+        semaphore_list[id] = key;
+        semaphores[id] = new Semaphore("sem", 1);
+        semaphore_count++;
+
+        (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+    }
+
+    // Return the id of the created Semaphore
+    machine->WriteRegister(2, id);
+}
+
+static void
+SysSemOp()
+{
+    int id = machine->ReadRegister(4);
+    int adj = machine->ReadRegister(5);
+
+    // We assusme that the semaphore implementation is a binary semaphore
+    // implementation, since P and V are atomic, we needn't disable the
+    // interrupts 
+    if(semaphore_list[id] != -1 && id < semaphore_count) {
+        if ( adj == -1 ){
+            semaphores[id]->P();
+        } else {
+            semaphores[id]->V();
+        }
+    }
+}
+
+static void
+SysSemCtl()
+{
+    // Obtain the passed parameters
+    int id = machine->ReadRegister(4);
+    int op = machine->ReadRegister(5);
+    int vaddr = machine->ReadRegister(6);
+    int value, returnValue = -1;
+
+    // First check whether the id is valid or not
+    if(semaphore_list[id] != -1 && id < semaphore_count) {
+        if( op == SYNCH_REMOVE ) {
+            semaphore_list[id] = -1;
+            delete semaphores[id];
+            returnValue = 0;
+        } else if ( op == SYNCH_GET ) {
+            // Return the value of the semaphore into the int at vaddr
+            value = WordToMachine(semaphores[id]->getValue());
+            if(CopyToUser(vaddr, (char *)&value, sizeof(int)) != -1) {
+                returnValue = 0;
+            }
+        } else if ( op == SYNCH_SET ) {
+            // Set the value of the semaphore to the int stored at vaddr
+            if(CopyFromUser(vaddr, (char *)&value, sizeof(int)) != -1) {
+                IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+                semaphores[id]->setValue(WordToHost(value));
+                (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+                returnValue = 0;
+            }
+        }
+    } 
+
+    machine->WriteRegister(2, returnValue);
+}
+
+static void
+SysCondGet()
+{
+    // Obtain the Key
+    int key = machine->ReadRegister(4);
+    int id, i;
+
+    // Check if the cv exists, if so then just return the value
+    // otherwise we will have to create a new cv 
+    id = -1;
+    for( i = 0; i<cv_count; ++i ) {
+        if( cv_list[i] == key ) {
+            id = i;
+        }
+    }
+
+    // If we have to create a new cv, we make sure that we disable
+    // interrupts, the reason being that cv_count is a global
+    // variable and so is the cvs array
+    // If the cv does not exists then create a new one
+    if ( id == -1 ) {
+        IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
+    
+        id = cv_count;
+        cv_list[id] = key;
+        cvs[id] = new Condition("cv");
+        cv_count++;
+
+        (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+    }
+
+    // Return the id of the created CV 
+    machine->WriteRegister(2, id);
+}
+
+static void
+SysCondOp()
+{
+    int id = machine->ReadRegister(4);
+    int op = machine->ReadRegister(5);
+    int sem = machine->ReadRegister(6);
+
+    // Interrupts needn't be disabled because this code is guranteed to be
+    // atomic by the mutex protecting the CV
+    if(cv_list[id] != -1 && semaphore_list[sem] !=-1 && sem < semaphore_count && id < cv_count) {
+        if(op == COND_OP_WAIT) {
+            cvs[id]->Wait(semaphores[sem]);
+        } else if (op == COND_OP_SIGNAL) {
+            cvs[id]->Signal();
+        } else if (op == COND_OP_BROADCAST) {
+            cvs[id]->Broadcast();
+        }
     }
-    else if ((which == SyscallException) && (type == SC_GetReg)) {
-       machine->WriteRegister(2, machine->ReadRegister(machine->ReadRegister(4))); // Return value
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+}
+
+static void
+SysCondRemove()
+{
+    int id = machine->ReadRegister(4);
+    int returnValue = -1;
+
+    // Interrupts needn't be disabled because this code is guranteed to be
+    // atomic by the mutex protecting the CV
+    if(cv_list[id] != -1 && id < cv_count) {
+        cv_list[id] = -1;
+        delete cvs[id];
+        returnValue = 0;
     }
-    else if ((which == SyscallException) && (type == SC_GetPA)) {
-       vaddr = machine->ReadRegister(4);
-       machine->WriteRegister(2, machine->GetPA(vaddr));  // Return value
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+
+    machine->WriteRegister(2, returnValue);
+}
+
+static void
+SysRingSetup()
+{
+    int addr = machine->ReadRegister(4);
+    int size = machine->ReadRegister(5);
+    RingState *ring;
+
+    // Also checks that the header is in the address space
+    if ((size <= 0) || (size > MaxRingSize) || (addr & 3)
+		|| !WriteUserWord(addr + RING_SIZE, size)
+		|| !WriteUserWord(addr + RING_TAIL, 0)
+		|| !WriteUserWord(addr + RING_DONE, 0)) {
+       machine->WriteRegister(2, -1);
+       return;
     }
-    else if ((which == SyscallException) && (type == SC_GetPID)) {
-       machine->WriteRegister(2, currentThread->GetPID());
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    StopRing();			// the old one, if any
+
+    ring = new RingState(addr, size);
+    ring->worker = new Thread("ring worker", GET_NICE_FROM_PARENT);
+    ring->worker->space = currentThread->space;
+    ring->worker->backupMemory = currentThread->backupMemory;
+    ring->worker->SaveUserState();
+    ring->worker->StackAllocate(RingWorker, 0);
+    rings[currentThread->GetPID()] = ring;
+    workerRings[ring->worker->GetPID()] = ring;
+    ring->worker->Schedule();
+    machine->WriteRegister(2, 0);
+}
+
+static void
+SysSubmit()
+{
+    RingState *ring = rings[currentThread->GetPID()];
+    int wait = machine->ReadRegister(4);
+    int tail, count;
+
+    // The program may only submit what fits in the free entries
+    if ((ring == NULL) || !ReadUserWord(ring->ringAddr + RING_TAIL, &tail)) {
+       machine->WriteRegister(2, -1);
+       return;
     }
-    else if ((which == SyscallException) && (type == SC_GetPPID)) {
-       machine->WriteRegister(2, currentThread->GetPPID());
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    count = (int)((unsigned)tail - ring->submitted);
+    if ((count < 0) || (count > ring->size - (int)(ring->submitted - ring->completed))) {
+       machine->WriteRegister(2, -1);
+       return;
     }
-    else if ((which == SyscallException) && (type == SC_Sleep)) {
-       sleeptime = machine->ReadRegister(4);
-       if (sleeptime == 0) {
-          // emulate a yield
-          currentThread->Yield();
-       }
-       else {
-          currentThread->SortedInsertInWaitQueue (sleeptime+stats->totalTicks);
-       }
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    if (count > 0) {
+       ring->submitted = tail;
+       ring->work->V();
     }
-    else if ((which == SyscallException) && (type == SC_Time)) {
-       machine->WriteRegister(2, stats->totalTicks);
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    if (wait)
+       WaitForRing(ring, ring->submitted);
+    machine->WriteRegister(2, count);
+}
+
+// The system calls, indexed by their code (see syscall.h).  The ones
+// without a handler (the file system calls) are not implemented.
+
+class SyscallEntry {
+  public:
+    char *name;			// for the statistics
+    VoidNoArgFunctionPtr handler;
+    bool advancePC;		// FALSE if the handler never returns,
+				// or advances the PC itself
+    bool inRing;		// can be run from a system call ring
+};
+
+static SyscallEntry syscallTable[] = {
+    { "Halt",		SysHalt,	FALSE,	FALSE },	// SC_Halt
+    { "Exit",		SysExit,	FALSE,	FALSE },	// SC_Exit
+    { "Exec",		SysExec,	TRUE,	FALSE },	// SC_Exec
+    { "Join",		SysJoin,	TRUE,	FALSE },	// SC_Join
+    { "Create",		NULL,		TRUE,	FALSE },	// SC_Create
+    { "Open",		NULL,		TRUE,	FALSE },	// SC_Open
+    { "Read",		NULL,		TRUE,	FALSE },	// SC_Read
+    { "Write",		NULL,		TRUE,	FALSE },	// SC_Write
+    { "Close",		NULL,		TRUE,	FALSE },	// SC_Close
+    { "Fork",		SysFork,	FALSE,	FALSE },	// SC_Fork
+    { "Yield",		SysYield,	TRUE,	TRUE },	// SC_Yield
+    { "PrintInt",	SysPrintInt,	TRUE,	TRUE },	// SC_PrintInt
+    { "PrintChar",	SysPrintChar,	TRUE,	TRUE },	// SC_PrintChar
+    { "PrintString",	SysPrintString,	TRUE,	TRUE },	// SC_PrintString
+    { "GetReg",		SysGetReg,	TRUE,	FALSE },	// SC_GetReg
+    { "GetPA",		SysGetPA,	TRUE,	TRUE },	// SC_GetPA
+    { "GetPID",		SysGetPID,	TRUE,	FALSE },	// SC_GetPID
+    { "GetPPID",	SysGetPPID,	TRUE,	FALSE },	// SC_GetPPID
+    { "Sleep",		SysSleep,	TRUE,	TRUE },	// SC_Sleep
+    { "Time",		SysTime,	TRUE,	TRUE },	// SC_Time
+    { "PrintIntHex",	SysPrintIntHex,	TRUE,	TRUE },	// SC_PrintIntHex
+    { "SemGet",		SysSemGet,	TRUE,	TRUE },	// SC_SemGet
+    { "SemOp",		SysSemOp,	TRUE,	TRUE },	// SC_SemOp
+    { "SemCtl",		SysSemCtl,	TRUE,	TRUE },	// SC_SemCtl
+    { "CondGet",	SysCondGet,	TRUE,	TRUE },	// SC_CondGet
+    { "CondOp",		SysCondOp,	TRUE,	TRUE },	// SC_CondOp
+    { "CondRemove",	SysCondRemove,	TRUE,	TRUE },	// SC_CondRemove
+    { "ShmAllocate",	SysShmAllocate,	TRUE,	FALSE },	// SC_ShmAllocate
+    { "RingSetup",	SysRingSetup,	TRUE,	FALSE },	// SC_RingSetup
+    { "Submit",		SysSubmit,	TRUE,	FALSE },	// SC_Submit
+};
+
+#define NumSyscalls	(int)(sizeof(syscallTable) / sizeof(SyscallEntry))
+
+//----------------------------------------------------------------------
+// RunHandler
+// 	Run the handler of system call "type".  Every call is counted,
+//	and the simulated and host time until it returns is added to its
+//	histograms.
+//----------------------------------------------------------------------
+
+static void
+RunHandler(int type)
+{
+    SyscallEntry *entry = &syscallTable[type];
+    int startTicks;
+    long long startNs;
+
+    stats->syscallName[type] = entry->name;
+    stats->syscallCalls[type]++;
+
+    startTicks = stats->totalTicks;
+    startNs = HostNanoseconds();
+    (*entry->handler)();
+    stats->RecordSyscall(type, stats->totalTicks - startTicks,
+			 HostNanoseconds() - startNs);
+}
+
+//----------------------------------------------------------------------
+// DoSyscall
+// 	Run system call "type" through syscallTable, then advance the PC
+//	for it.
+//----------------------------------------------------------------------
+
+static void
+DoSyscall(int type)
+{
+    if ((type < 0) || (type >= NumSyscalls)
+		|| (syscallTable[type].handler == NULL)) {
+        printf("Unexpected user mode exception %d %d\n", SyscallException, type);
+        ASSERT(FALSE);
     }
-    else if ((which == SyscallException) && (type == SC_PrintIntHex)) {
-       printvalus = (unsigned)machine->ReadRegister(4);
-       writeDone->P() ;
-       console->PutChar('0');
-       writeDone->P() ;
-       console->PutChar('x');
-       if (printvalus == 0) {
-          writeDone->P() ;
-          console->PutChar('0');
-       }
-       else {
-          ConvertIntToHex (printvalus, console);
-       }
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-    } else if ((which == SyscallException) && (type == SC_ShmAllocate)) {
-       sharedSize = machine->ReadRegister(4);
-       int pagesCreated;
-
-       // create a new Page table with shared pages
-       sharedMemoryStart = (unsigned)currentThread->space->createSharedPageTable(sharedSize, &pagesCreated);
-
-       // Increment the number of page faults
-       stats->numPageFaults += pagesCreated;
-
-       // Advance program counters.
-       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-
-       // Return the starting address of the shared memory region
-       machine->WriteRegister(2, sharedMemoryStart);
-    } else if ((which == SyscallException) && (type == SC_SemGet)) {
-        // Obtain the Key
-        key = machine->ReadRegister(4);
-
-        // Check if the semaphore exists, if so then just return the value
-        // otherwise we will have to create a new semaphore
-        id = -1;
-        for( i = 0; i<semaphore_count; ++i ) {
-            if( semaphore_list[i] == key ) {
-                id = i;
-            }
-        }
+    RunHandler(type);
+    if (syscallTable[type].advancePC)
+        AdvancePC();
+}
 
-        // If we have to create a new semaphore, we make sure that we disable
-        // interrupts, the reason being that semaphore_count is a global
-        // variable and so is the semaphores array
-        // If the semaphore does not exists then create a new one
-        if ( id == -1 ) {
-            IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
-        
-            id = semaphore_count;
-            semaphore_list[id] = key;
-            semaphores[id] = new Semaphore("sem", 1);
-            semaphore_count++;
-
-            (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
-        }
-        
-        // Advance program counters.
-        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-
-        // Return the id of the created Semaphore
-        machine->WriteRegister(2, id);
-    } else if ((which == SyscallException) && (type == SC_SemOp)) {
-        id = machine->ReadRegister(4);
-        adj = machine->ReadRegister(5);
-
-        // We assusme that the semaphore implementation is a binary semaphore
-        // implementation, since P and V are atomic, we needn't disable the
-        // interrupts 
-        if(semaphore_list[id] != -1 && id < semaphore_count) {
-            if ( adj == -1 ){
-                semaphores[id]->P();
-            } else {
-                semaphores[id]->V();
-            }
-        }
+//----------------------------------------------------------------------
+// RunRingEntry
+// 	Run the request in entry "index" of "ring", and write its result
+//	back into the entry.  A request that cannot be read, or that is
+//	not allowed in a ring, fails with -1.
+//----------------------------------------------------------------------
 
-        // Advance program counters.
-        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-    } else if ((which == SyscallException) && (type == SC_SemCtl)) {
-        // Obtain the passed parameters
-        id = machine->ReadRegister(4);
-        op = machine->ReadRegister(5);
-        vaddr = machine->ReadRegister(6);
-        returnValue = -1;
-
-        // First check whether the id is valid or not
-        if(semaphore_list[id] != -1 && id < semaphore_count) {
-            if( op == SYNCH_REMOVE ) {
-                semaphore_list[id] = -1;
-                delete semaphores[id];
-                returnValue = 0;
-            } else if ( op == SYNCH_GET ) {
-                // Translare the vaddr to a paddr and then return the value of the
-                // semaphore into this address
-                paddr = machine->GetPA(vaddr);
-                if(paddr != -1) {
-                    machine->mainMemory[paddr] = semaphores[id]->getValue();
-                    returnValue = 0;
-                }
-            } else if ( op == SYNCH_SET ) {
-                // Translate the vaddr to a paddr and then write the value stored at
-                // that location in to the value of the semaphore
-                paddr = machine->GetPA(vaddr);
-                if(paddr != -1) {
-                    IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
-                    semaphores[id]->setValue(machine->mainMemory[paddr]);
-                    (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
-                    returnValue = 0;
-                }
-            }
-        } 
-
-        // Advance program counters.
-        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-
-        // Return the starting address of the shared memory region
-        machine->WriteRegister(2, returnValue);
-    } else if ((which == SyscallException) && (type == SC_CondGet)) {
-        // Obtain the Key
-        key = machine->ReadRegister(4);
-
-        // Check if the cv exists, if so then just return the value
-        // otherwise we will have to create a new cv 
-        id = -1;
-        for( i = 0; i<cv_count; ++i ) {
-            if( cv_list[i] == key ) {
-                id = i;
-            }
+static void
+RunRingEntry(RingState *ring, unsigned index)
+{
+    int entry = ring->ringAddr + RING_ENTRIES + (index % ring->size) * RING_ENTRY_SIZE;
+    int words[RING_ENTRY_SIZE / 4];
+    int code, result = -1;
+
+    if (CopyFromUser(entry, (char *)words, RING_ENTRY_SIZE) != -1) {
+        code = WordToHost(words[RING_CODE / 4]);
+        if ((code >= 0) && (code < NumSyscalls) && syscallTable[code].inRing) {
+            for (int i = 0; i < 3; i++)
+                machine->WriteRegister(4 + i, WordToHost(words[RING_ARG / 4 + i]));
+            machine->WriteRegister(2, 0);
+            RunHandler(code);
+            result = machine->ReadRegister(2);
         }
+    }
+    (void) WriteUserWord(entry + RING_RESULT, result);
+}
+
+//----------------------------------------------------------------------
+// RingWorker
+// 	The body of a ring's worker thread.  Each time Submit wakes it
+//	up, run the requests handed over so far, in order, advancing the
+//	ring's "done" after each, then wake up whoever waits for them.
+//	Once the ring is stopped, exit; StopRing has already taken the
+//	address space away from us.
+//----------------------------------------------------------------------
 
-        // If we have to create a new cv, we make sure that we disable
-        // interrupts, the reason being that cv_count is a global
-        // variable and so is the cvs array
-        // If the cv does not exists then create a new one
-        if ( id == -1 ) {
-            IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
-        
-            id = cv_count;
-            cv_list[id] = key;
-            cvs[id] = new Condition("cv");
-            cv_count++;
-
-            (void) interrupt->SetLevel(oldLevel);	// re-enable interrupts
+static void
+RingWorker(int dummy)
+{
+    RingState *ring = workerRings[currentThread->GetPID()];
+    IntStatus oldLevel;
+
+    currentThread->Startup();
+    for (;;) {
+        ring->work->P();
+        if (ring->stopping)
+            break;
+        while (ring->completed != ring->submitted) {
+            RunRingEntry(ring, ring->completed);
+            ring->completed++;
+            (void) WriteUserWord(ring->ringAddr + RING_DONE, ring->completed);
         }
-        
-        // Advance program counters.
-        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-
-        // Return the id of the created CV 
-        machine->WriteRegister(2, id);
-    } else if ((which == SyscallException) && (type == SC_CondOp)) {
-        id = machine->ReadRegister(4);
-        op = machine->ReadRegister(5);
-        sem = machine->ReadRegister(6);
-
-        // Interrupts needn't be disabled because this code is guranteed to be
-        // atomic by the mutex protecting the CV
-        if(cv_list[id] != -1 && semaphore_list[sem] !=-1 && sem < semaphore_count && id < cv_count) {
-            if(op == COND_OP_WAIT) {
-                cvs[id]->Wait(semaphores[sem]);
-            } else if (op == COND_OP_SIGNAL) {
-                cvs[id]->Signal();
-            } else if (op == COND_OP_BROADCAST) {
-                cvs[id]->Broadcast();
-            }
+        oldLevel = interrupt->SetLevel(IntOff);
+        while (ring->numWaiting > 0) {
+            ring->numWaiting--;
+            ring->progress->V();
         }
+        (void) interrupt->SetLevel(oldLevel);
+    }
+    workerRings[currentThread->GetPID()] = NULL;
+    delete ring;
+    ExitThread(0);
+}
 
-        // Advance program counters.
-        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
-    } else if ((which == SyscallException) && (type == SC_CondRemove)) {
-        id = machine->ReadRegister(4);
-        returnValue = -1;
-
-        // Interrupts needn't be disabled because this code is guranteed to be
-        // atomic by the mutex protecting the CV
-        if(cv_list[id] != -1 && id < cv_count) {
-            cv_list[id] = -1;
-            delete cvs[id];
-            returnValue = 0;
-        }
+void
+ExceptionHandler(ExceptionType which)
+{
+    int type = machine->ReadRegister(2);
+    PROFILE(ProfException);
+
+    // With a TLB, most page faults are TLB misses, and most read-only
+    // faults are first stores to a clean page; both are handled here
+    // and the instruction is retried
+    if (machine->tlb != NULL) {
+        if ((which == PageFaultException) && HandleTLBMiss())
+            return;
+        if ((which == ReadOnlyException) && HandleTLBWrite())
+            return;
+    }
 
-        // Advance program counters.
-        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    if (consoleDriver == NULL)
+       consoleDriver = new ConsoleDriver(NULL);
 
-        // Return the starting address of the shared memory region
-        machine->WriteRegister(2, returnValue);
+    if (which == SyscallException) {
+        DoSyscall(type);
     } else if (which == PageFaultException)  {
         // Set the status of the thread to BLOCKED and then it goes for sleep
         // for a 1000 ticks, to model the pageFault latency
@@ -139,13 +139,14 @@ ConsoleTest (char *in, char *out)
 
 //--------------------------------------------------------------------------------------------------
 // ReadInputAndFork (multiprogramming test)
-//	Read the scheduling algorithm.
+//	Read the scheduling algorithm, unless "algo" (given with -A) is not 0:
+//	then it is used instead, so that one batch can be run under every algorithm.
 //      Read a set of user programs along with the priorities.  Open the executables, load them into
 //      memory, and invoke the scheduler.
 //---------------------------------------------------------------------------------------------------
 
 void
-ReadInputAndFork (char *filename)
+ReadInputAndFork (char *filename, int algo)
 {
    OpenFile *inFile = fileSystem->Open(filename);
    char c, buffer[16];
@@ -166,9 +167,12 @@ ReadInputAndFork (char *filename)
       inFile->Read(&c, 1);
    }
 
+   if (algo != 0)
+      schedulingAlgo = algo;
    //printf("%d\n", schedulingAlgo);
 
-   if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
+   ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= LOTTERY_SCHED));
+   if (scheduler->Preemptive()) {
       ASSERT (SCHED_QUANTUM > 0);
    }
 
@@ -208,6 +212,7 @@ ReadInputAndFork (char *filename)
       sprintf(buffer,"Thread_%d",i+1);
       Thread *child = new Thread(buffer, priority[i]);
       child->space = new AddrSpace (inFile);
+      strcpy(child->space->filename, batchProcesses[i]);
       delete inFile;
       child->space->InitRegisters();             // set the initial register values
       child->SaveUserState ();
@@ -57,6 +57,31 @@
 
 #define SC_ShmAllocate	27
 
+#define SC_RingSetup	28
+#define SC_Submit	29
+
+/* The vDSO page: kernel data that appears, read-only, at the same
+ * address in every address space, so that the stubs of GetTime, GetPID
+ * and GetPPID can read it instead of trapping.  Each field is a word.
+ */
+#define VDSO_ADDR	0x7fff0000
+#define VDSO_TICKS	0	/* the current time, in ticks */
+#define VDSO_PID	4	/* the pid of the reading thread */
+#define VDSO_PPID	8	/* and of its parent */
+#define VDSO_SIZE	12
+
+/* Layout of a system call ring (see Ring below), in bytes, for the
+ * kernel.  Each field is a word.
+ */
+#define RING_SIZE	0	/* number of entries */
+#define RING_TAIL	4	/* requests submitted, ever */
+#define RING_DONE	8	/* requests completed, ever */
+#define RING_ENTRIES	12
+#define RING_CODE	0	/* in each entry */
+#define RING_ARG	4
+#define RING_RESULT	16
+#define RING_ENTRY_SIZE	20
+
 #ifndef IN_ASM
 
 /* The system call interface.  These are the operations the Nachos
@@ -185,6 +210,42 @@ void CondOp (int condid, unsigned op, int semid);
 int CondRemove (int condid);
 
 unsigned ShmAllocate (unsigned size);
+
+/* System call rings.  Instead of trapping once per system call, a
+ * program can write a batch of requests into a ring in its own memory
+ * and hand them all to the kernel with one Submit.  A worker thread,
+ * a child of the thread that set the ring up with a pid of its own,
+ * runs them in order, writes each result into its entry, and advances
+ * "done".  Entry i of the ring is entries[i % size]; an entry may only
+ * be reused once "done" has passed it.  Only the system calls that do
+ * not act on the calling thread itself can be put in a ring (the Print
+ * calls, Sleep, Yield, GetTime, GetPA and the semaphore and condition
+ * calls); any other gets the result -1.
+ */
+typedef struct {
+    int code;		/* SC_xxx */
+    int arg[3];		/* its arguments */
+    int result;		/* its return value, once done */
+} RingEntry;
+
+typedef struct {
+    int size;		/* number of entries, set by RingSetup */
+    int tail;		/* requests written by the program, ever */
+    int done;		/* requests completed by the kernel, ever */
+    RingEntry entries[1];	/* really "size" of them */
+} Ring;
+
+/* Use "ring", with room for "size" entries, for this program's system
+ * call ring, and reset it.  Return 0, or -1 if it cannot be used.
+ */
+int RingSetup (Ring *ring, int size);
+
+/* Hand the requests written up to ring->tail to the kernel.  If "wait"
+ * is non-zero, return only once they have all been completed.  Return
+ * the number of requests handed over, or -1 if there is no ring or the
+ * tail is not valid.
+ */
+int Submit (int wait);
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */